@@ -1,12 +1,46 @@
 #include "Agent.h"
+#include "DStarLite.h"
 
-Agent::Agent(GameApplication* game, Ogre::SceneManager* SceneManager, std::string name, std::string filename, float height, float scale)
+#ifdef HEADLESS
+// the headless build has no body, so there is nothing to load; the agent is just its slot
+Agent::Agent(Simulation* game, float height, float scale)
+{
+	mGame = game;				// a pointer to the simulation
+
+	// claim a slot in the boid state, standing on the plane with the default walk speed
+	mFlock = &mGame->getFlockState();
+	mSlot = mFlock->add(Vector3(0, height, 0), 25.0f);
+
+	this->height = height;
+	this->scale = scale;
+
+	mBaseAnimID = ANIM_IDLE_BASE;
+	mTopAnimID = ANIM_IDLE_TOP;
+
+	// configure walking parameters (speed, direction and flocking were set with the slot)
+	mWalking = false;
+	mMoving = false;
+
+	mGrid = NULL;
+	mGridNode = NULL;
+	mNextNode = NULL;
+	mFlowGoal = NULL;
+	mPathTicket = 0;
+	mPlanner = NULL;
+	mPlanning = false;
+}
+#else
+Agent::Agent(Simulation* game, Ogre::SceneManager* SceneManager, std::string name, std::string filename, float height, float scale)
 {
 	using namespace Ogre;
 
 	mGame = game;				// a pointer to the game application
 	mSceneMgr = SceneManager;	// keep a pointer to where this agent will be
 
+	// claim a slot in the boid state, standing on the plane with the default walk speed
+	mFlock = &mGame->getFlockState();
+	mSlot = mFlock->add(Vector3(0, height, 0), 25.0f);
+
 	if (mSceneMgr == NULL)
 	{
 		std::cout << "ERROR: No valid scene manager in Agent constructor" << std::endl;
@@ -25,20 +59,23 @@ Agent::Agent(GameApplication* game, Ogre::SceneManager* SceneManager, std::strin
 
 	setupAnimations();  // load the animation for this character
 
-	// configure walking parameters
+	// configure walking parameters (speed, direction and flocking were set with the slot)
 	mWalking = false;
-	mWalkSpeed = 25.0f;	
-	mDirection = Ogre::Vector3::ZERO;
-
-	mFlocking = false;
-	//mDemo = false;
+	mMoving = false;
 
 	mGrid = NULL;
 	mGridNode = NULL;
 	mNextNode = NULL;
+	mFlowGoal = NULL;
+	mPathTicket = 0;
+	mPlanner = NULL;
+	mPlanning = false;
 }
+#endif
 
 Agent::~Agent(){
+	if (mPlanner != NULL)
+		delete mPlanner;
 	// mSceneMgr->destroySceneNode(mBodyNode); // Note that OGRE does not recommend doing this. It prefers to use clear scene
 	// mSceneMgr->destroyEntity(mBodyEntity);
 }
@@ -47,7 +84,39 @@ Agent::~Agent(){
 void 
 Agent::setPosition(float x, float y, float z)
 {
-	this->mBodyNode->setPosition(x, y + height , z); 
+	mFlock->place(mSlot, Vector3(x, y + height, z));
+	syncNode();
+}
+
+//get the position of the agent
+Vector3
+Agent::getPosition()
+{
+	return mFlock->getPosition(mSlot);
+}
+
+//push the simulated position to the scene node
+//called once per frame by Simulation::syncNodes, after the frame's steps have run
+void
+Agent::syncNode(Real alpha)
+{
+#ifndef HEADLESS
+	this->mBodyNode->setPosition(mFlock->getDrawPosition(mSlot, alpha));
+#else
+	(void)alpha;	// nothing to draw
+#endif
+}
+
+Vector3
+Agent::getDirection()
+{
+	return mFlock->getDirection(mSlot);
+}
+
+void
+Agent::setDirection(const Vector3& dir)
+{
+	mFlock->setDirection(mSlot, dir);
 }
 
 void
@@ -61,17 +130,66 @@ void
 Agent::setGrid(Grid* g)
 {
 	this->mGrid = g;
+	mPlanning = false;	//the plan was for the old grid
 }
 
-// update is called at every frame from GameApplication::addTime
+// update the agent in one go. Simulation::step runs the same
+// three phases, but over every agent at a time so move() can run on the job system
 void
-Agent::update(Ogre::Real deltaTime) 
+Agent::update(Real deltaTime) 
+{
+	think(deltaTime);
+	move(deltaTime);
+	apply();
+	syncNode();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// main thread phase: animations, arrivals and the walk list.
+// these touch Ogre and other agents, so they stay serial
+void
+Agent::think(Real deltaTime)
 {
 	this->updateAnimations(deltaTime);	// Update animation playback
 	this->updateLocomote(deltaTime);	// Update Locomotion
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// job phase: integrate the agent's position.
+// reads other agents only through the spatial hash snapshot and writes only
+// this agent's own flock slot and scratch lists, so agents can move in parallel
+void
+Agent::move(Real deltaTime)
+{
+	mNeighbors.clear();
+	if (!mMoving) { return; }
 
+	if (!isFlocking())
+	{
+		Real move = (mFlock->speed[mSlot] * deltaTime);
+		mFlock->setPosition(mSlot, getPosition() + getDirection() * move);	//translate normally
+	}
+	else //flocking
+	{
+		mGame->getNeighbors(getPosition(), mNeighbors);	//anyone nearby gets assimilated in apply()
+		Vector3 flocking = vFlock();
+		mFlock->setPosition(mSlot, getPosition() + flocking * (deltaTime * FLOCK_RATE));	//translate with flocking velocity
+		//rotation code is causing break dancing
+		//rotate(flocking);					//rotated based on flocking velocity
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// main thread phase: write what move() decided back to shared state.
+// the scene node is moved later, once per frame (syncNode)
+void
+Agent::apply()
+{
+	assimilate();
+}
+
+
+#ifndef HEADLESS
 void 
 Agent::setupAnimations()
 {
@@ -103,9 +221,15 @@ Agent::setupAnimations()
 	mAnims[ANIM_HANDS_RELAXED]->setEnabled(true);
 }
 
+#endif
+
 void 
 Agent::setBaseAnimation(AnimID id, bool reset)
 {
+#ifdef HEADLESS
+	mBaseAnimID = id;	// nothing to blend, just remember what would be playing
+	(void)reset;
+#else
 	if (mBaseAnimID >= 0 && mBaseAnimID < 13)
 	{
 		// if we have an old animation, fade it out
@@ -124,10 +248,15 @@ Agent::setBaseAnimation(AnimID id, bool reset)
 		mFadingIn[id] = true;
 		if (reset) mAnims[id]->setTimePosition(0);
 	}
+#endif
 }
 	
 void Agent::setTopAnimation(AnimID id, bool reset)
 {
+#ifdef HEADLESS
+	mTopAnimID = id;
+	(void)reset;
+#else
 	if (mTopAnimID >= 0 && mTopAnimID < 13)
 	{
 		// if we have an old animation, fade it out
@@ -146,11 +275,13 @@ void Agent::setTopAnimation(AnimID id, bool reset)
 		mFadingIn[id] = true;
 		if (reset) mAnims[id]->setTimePosition(0);
 	}
+#endif
 }
 
 void 
-Agent::updateAnimations(Ogre::Real deltaTime)
+Agent::updateAnimations(Real deltaTime)
 {
+#ifndef HEADLESS
 	using namespace Ogre;
 
 	Real baseAnimSpeed = 1;
@@ -174,8 +305,12 @@ Agent::updateAnimations(Ogre::Real deltaTime)
 
 	// apply smooth transitioning between our animations
 	fadeAnimations(deltaTime);
+#else
+	(void)deltaTime;	// no animations to play
+#endif
 }
 
+#ifndef HEADLESS
 void 
 Agent::fadeAnimations(Ogre::Real deltaTime)
 {
@@ -203,6 +338,7 @@ Agent::fadeAnimations(Ogre::Real deltaTime)
 		}
 	}
 }
+#endif
 
 ////////////////////////////////////////////////////////////////////
 //checks to see if there is a destination available in the mWalkList
@@ -211,6 +347,30 @@ Agent::fadeAnimations(Ogre::Real deltaTime)
 bool 
 Agent::nextLocation()
 {
+	if ( mWalkList.empty() && mFlowGoal != NULL )	//following a flow field, it knows the next node
+	{
+		GridNode* next = mGrid->flowTo(mFlowGoal)->getNext(mGrid, mGridNode);
+		if (next != NULL)
+		{
+			Vector3 destination = next->getPosition( mGrid->getNumRows(), mGrid->getNumCols() );
+			destination[1] = this->height + height;	//same height walkTo uses
+			mWalkList.push_back(destination);
+			mNextNode = next;
+		}
+		else { mFlowGoal = NULL; }	//at the goal, or it can't be reached from here
+	}
+	if ( mWalkList.empty() && mPlanning )	//planning, ask for the next step (the plan is repaired first if the grid changed)
+	{
+		GridNode* next = mPlanner->getNext(mGridNode);
+		if (next != NULL)
+		{
+			Vector3 destination = next->getPosition( mGrid->getNumRows(), mGrid->getNumCols() );
+			destination[1] = this->height + height;
+			mWalkList.push_back(destination);
+			mNextNode = next;
+		}
+		else { mPlanning = false; }	//at the goal, or it can't be reached any more
+	}
 	if ( mWalkList.empty() ) //any destinations to walk to?
 	{
 		mWalking = false;
@@ -221,12 +381,12 @@ Agent::nextLocation()
 	mDestination = mWalkList.front();	// get next destination
 	mWalkList.pop_front();				// remove from queue
 
-	mDirection = mDestination - mBodyNode->getPosition();	//set direction
-
-	mDistance = mDirection.normalise();
+	Vector3 direction = mDestination - getPosition();	//set direction
+	mDistance = direction.normalise();
+	setDirection(direction);
 
 	// Rotation code will go here, moved from updateLocomote
-	rotate(mDirection);
+	rotate(direction);
 
 	return true;
 }
@@ -234,8 +394,9 @@ Agent::nextLocation()
 //////////////////////////////////////////////////////////////////////////////
 //update animations and move the agent according to //NOdeltaTimeNO// distance
 void 
-Agent::updateLocomote(Ogre::Real deltaTime)
+Agent::updateLocomote(Real)	// the move itself is a job now (Simulation::update), this only picks the next node
 {
+	mMoving = false;
 	if ( !mWalking ) //faster to use a bool than compare vectors
 	{ 
 		if ( nextLocation() ) 
@@ -246,14 +407,22 @@ Agent::updateLocomote(Ogre::Real deltaTime)
 		}
 	}
 	else { 
-		mDistance = (mDestination - mBodyNode->getPosition()).normalise();
+		mDistance = (mDestination - getPosition()).normalise();
 
 		if ( mDistance <= 5.0f )	// destination reached! //assign a constant? magic number is magic
 		{
 			//mBodyNode->setPosition(mDestination); //don't want them to sit on top of each other
-			mDirection = Ogre::Vector3::ZERO;
+			setDirection(Vector3::ZERO);
 			if (mNextNode != NULL) { mGridNode = mNextNode; }
-			if ( !nextLocation() )	//no other point to walk to, Idle ogre is idle
+			if (mFlowGoal != NULL || mPlanning)	//on a flow field or a plan every agent goes its own way, no flock to hold up
+			{
+				if ( !nextLocation() )
+				{
+					setBaseAnimation(ANIM_IDLE_BASE);
+					setTopAnimation(ANIM_IDLE_TOP);
+				}
+			}
+			else if ( !nextLocation() )	//no other point to walk to, Idle ogre is idle
 			{
 				// set Idle animation
 				setBaseAnimation(ANIM_IDLE_BASE);
@@ -261,15 +430,15 @@ Agent::updateLocomote(Ogre::Real deltaTime)
 
 				//if part of a flock, stop the flock and idle them too
 				//so flock stops when one of them arrives at the destination
-				if (mFlocking)
+				if (isFlocking())
 				{
-					std::list<Agent*> agentList = mGame->getAgentList();
-					std::list<Agent*>::iterator iter;
+					const std::vector<Agent*>& agentList = mGame->getAgentList();
+					std::vector<Agent*>::const_iterator iter;
 					for (iter = agentList.begin(); iter != agentList.end(); iter++)
 					{
-						if ((*iter)->mFlocking)
+						if ((*iter)->isFlocking())
 						{
-							(*iter)->mDirection = Ogre::Vector3::ZERO;
+							(*iter)->setDirection(Vector3::ZERO);
 							(*iter)->setBaseAnimation(ANIM_IDLE_BASE);
 							(*iter)->setTopAnimation(ANIM_IDLE_TOP);
 						}
@@ -280,8 +449,8 @@ Agent::updateLocomote(Ogre::Real deltaTime)
 			{   //Need to fix this to allow multiple flocks
 				//first agent to arrive at destination will trigger this
 				//get destinations for the rest of the flock
-				std::list<Agent*> agentList = mGame->getAgentList();
-				std::list<Agent*>::iterator iter;
+				const std::vector<Agent*>& agentList = mGame->getAgentList();
+				std::vector<Agent*>::const_iterator iter;
 				for (iter = agentList.begin(); iter != agentList.end(); iter++)
 				{
 					if (*iter != NULL && *iter != this)
@@ -291,21 +460,9 @@ Agent::updateLocomote(Ogre::Real deltaTime)
 				}
 			}
 		}
-		else //destination not reached, continue moving
+		else //destination not reached, keep going
 		{ 
-			if (!mFlocking)
-			{
-				Ogre::Real move = (mWalkSpeed * deltaTime);
-				mBodyNode->translate(mDirection * move);	//translate normally
-			}
-			else //flocking
-			{
-				assimilate();						//assimilate any nearby agents, resistance is futile...
-				Ogre::Vector3 flocking = vFlock();
-				mBodyNode->translate(flocking);		//translate with flocking velocity
-				//rotation code is causing break dancing
-				//rotate(flocking);					//rotated based on flocking velocity
-			}
+			mMoving = true;		//move() does the translating
 		}
 	}
 }
@@ -313,8 +470,9 @@ Agent::updateLocomote(Ogre::Real deltaTime)
 ///////////////////////////////////////////////
 //rotate agent towards goal
 void
-Agent::rotate(Ogre::Vector3 towards)
+Agent::rotate(Vector3 towards)
 {
+#ifndef HEADLESS
  	Ogre::Vector3 src = mBodyNode->getOrientation() * Ogre::Vector3::UNIT_Z;
 	if ( (1.0f + src.dotProduct(towards)) < 0.0001f) 
 	{
@@ -325,6 +483,9 @@ Agent::rotate(Ogre::Vector3 towards)
 		Ogre::Quaternion quat = src.getRotationTo(towards);
 		mBodyNode->rotate(quat);
 	}
+#else
+	(void)towards;	// no body to turn
+#endif
 }
 
 ///////////////////////////////////////////////
@@ -338,7 +499,7 @@ Agent::genWalkList()
 	{
 		x = rand() % 60 - 30;
 		y = rand() % 60 - 30;
-		mWalkList.push_back(Ogre::Vector3(x, this->height, y));
+		mWalkList.push_back(Vector3(x, this->height, y));
 	}
 }
 
@@ -347,8 +508,11 @@ Agent::genWalkList()
 //when mWalklist is checked, the ogre will walk to this point.
 //presently overrides old destination whenever called.
 void
-Agent::walkTo(Ogre::Vector3 destination) 
+Agent::walkTo(Vector3 destination) 
 {   
+	mFlowGoal = NULL;	//an explicit destination overrides any flow field or plan
+	mPlanning = false;
+	cancelPath();		//and any path still being searched for
 	destination[1] = this->height + height;	//this keeps the orge above the grid
 	if ( mWalking && !mGame->inDemoMode())	// overrides old destination
 	{
@@ -364,7 +528,7 @@ void
 Agent::walkTo(GridNode* n)
 {
 	if (n== NULL || !n->isClear()) { return; }
-	Ogre::Vector3 destination = n->getPosition( mGrid->getNumRows(), mGrid->getNumCols() );
+	Vector3 destination = n->getPosition( mGrid->getNumRows(), mGrid->getNumCols() );
 	walkTo(destination);
 
 	mNextNode = n;	//need to handle updating current node position better
@@ -374,74 +538,129 @@ Agent::walkTo(GridNode* n)
 
 ///////////////////////////////////////////////////////////////////////
 //calculate a path to the given node destination avoiding all obstacles
-//utilizes A* algorithm to find the optimal path
-//once path is determined, pass each destination on the path to walkTo
+//utilizes A* algorithm to find the optimal path (through the grid's path cache,
+//so agents standing on the same node and heading for the same goal share one search)
+//the search runs on the simulation's path service, this returns straight
+//away and receivePath() walks the path once it has been found.
+//a goal that is blocked or walled off is turned down before anything is
+//searched (the grid knows its areas), or with snap swapped for the
+//nearest node that can be reached
 void
-Agent::moveTo(GridNode* n)
+Agent::moveTo(GridNode* n, int priority, bool snap)
 {
-	if ( mWalking ) { return; }
-	if (n== NULL || !n->isClear()) { return; }
+	n = destinationFor(n, snap);
+	if (n == NULL) { return; }
+	mFlowGoal = NULL;
+	mPlanning = false;
 
-	std::deque<GridNode*> path = mGrid->aStar(mGridNode, n);
-	while (!path.empty())
+	cancelPath();	//only the latest destination counts
+	mPathTicket = mGame->requestPath(this, mGridNode, n, priority);
+}
+
+///////////////////////////////////////////////////////////////////////
+//moveTo's checks on their own: not while walking, and not to a goal that
+//can't be reached (unless snapping to the nearest node that can)
+GridNode*
+Agent::destinationFor(GridNode* n, bool snap)
+{
+	if ( mWalking ) { return NULL; }
+	if (n == NULL || mGrid == NULL || mGridNode == NULL) { return NULL; }
+	if (!mGrid->isReachable(mGridNode, n))
 	{
-		walkTo(path.front());
-		path.pop_front();
+		if (!snap) { return NULL; }
+		n = mGrid->nearestReachable(mGridNode, n);
+		if (n == NULL || n == mGridNode) { return NULL; }
 	}
+	return n;
+}
+
+///////////////////////////////////////////////////////////////////////
+//main thread: a path the path service found. Anything but the answer to
+//the last moveTo (cancelled, or overridden by walkTo since) is dropped,
+//otherwise each destination on the path is passed to walkTo
+void
+Agent::receivePath(int ticket, const std::deque<GridNode*>& path)
+{
+	if (ticket == 0 || ticket != mPathTicket) { return; }
+	mPathTicket = 0;
+	for (unsigned int i = 0; i < path.size(); i++)
+		walkTo(path[i]);
+}
+
+void
+Agent::cancelPath()
+{
+	if (mPathTicket == 0) { return; }
+	mGame->cancelPath(mPathTicket);
+	mPathTicket = 0;
+}
+
+///////////////////////////////////////////////////////////////////////
+//walk to goal along the grid's flow field for it. The agent asks the
+//field for one node at a time as it arrives, so any number of agents can
+//share the one sweep that built it
+void
+Agent::followFlow(GridNode* goal)
+{
+	if (goal == NULL || !goal->isClear() || mGrid == NULL) { return; }
+	cancelPath();
+	mWalkList.clear();
+	mWalking = false;	//think() picks up the first node from the field
+	mPlanning = false;
+	mFlowGoal = goal;
+}
+
+///////////////////////////////////////////////////////////////////////
+//walk to goal along a D* Lite plan. Like the flow field the agent asks
+//for one node at a time, and if nodes have been blocked or cleared since
+//the last one the plan is repaired around them instead of searched again
+void
+Agent::planTo(GridNode* goal)
+{
+	if (goal == NULL || !goal->isClear() || mGrid == NULL || mGridNode == NULL) { return; }
+	cancelPath();
+	mWalkList.clear();
+	mWalking = false;	//think() picks up the first node from the plan
+	mFlowGoal = NULL;
+	if (mPlanner == NULL)
+		mPlanner = new DStarLite();
+	mPlanner->begin(mGrid, mGridNode, goal);
+	mPlanning = true;
 }
 
 ///////////////////////////////////////////////////////////////////////
 // calculate flocking velocity and return it
-Ogre::Vector3
+Vector3
 Agent::vFlock()
 {
-	if (!mFlocking) { mFlocking = true; }
-	int count = 0;	//number of agents compared
+	if (!isFlocking()) { mFlock->flocking[mSlot] = true; }
 
 	//vFlock = k1 * vSeperate + k2 * vAlign + k3 * vCohesion
-	//variables needed for that equation:
-	Ogre::Vector3 vSeparate = Ogre::Vector3::ZERO;
-	Ogre::Vector3 vAlign = Ogre::Vector3::ZERO;
-	Ogre::Vector3 vCohesion = Ogre::Vector3::ZERO;
-	Ogre::Vector3 xCenterOfMass = Ogre::Vector3::ZERO;
-	
-	//apply to every agent for now
-	std::list<Agent*> agentList = mGame->getAgentList();
-	std::list<Agent*>::iterator iter;
-	for (iter = agentList.begin(); iter != agentList.end(); iter++)
-	{
-		if (*iter != NULL && *iter != this)		//don't check agent with itself
-		if ((*iter)->mFlocking)					//is the agent flocking?
-		{
-			count++;	//number of agents checked
-
-			//--some calculations for Seperation --------------------------------------------------
-			Ogre::Vector3 dist = mBodyNode->getPosition() - (*iter)->mBodyNode->getPosition();
-			Ogre::Real length = dist.length();
-			dist = dist / (length * length);
-			vSeparate += dist;
-			//-------------------------------------------------------------------------------------
-
-			//--some calculations for Alignment ---------------------------------------------------
-			Ogre::Vector3 agentVelocity = (*iter)->mDirection;
-			agentVelocity.normalise();
-			vAlign += agentVelocity;
-			//-------------------------------------------------------------------------------------
-
-			xCenterOfMass += (*iter)->mBodyNode->getPosition(); //needed for cohesion
-		}
-	}
-	vSeparate = vSeparate * KSEPERATE;						//sereration velocity
-
-	vAlign = vAlign / count;
-	vAlign = vAlign - mDirection;
+	//the sums for that equation come from the SIMD kernel over the packed flockmates (see FlockKernel.h)
+	Vector3 pos = getPosition();
+	float x = pos.x, y = pos.y, z = pos.z;
+	mGame->getFlockmates(mSlot, pos, mFlockmates);
+	FlockSums sums;
+	getFlockKernel()(x, y, z, mFlockmates, sums);
+	int count = sums.count;	//number of agents compared
+	float sepX = sums.sepX, sepY = sums.sepY, sepZ = sums.sepZ;		//separation
+	float aliX = sums.aliX, aliY = sums.aliY, aliZ = sums.aliZ;		//alignment
+	float comX = sums.comX, comY = sums.comY, comZ = sums.comZ;		//center of mass, for cohesion
+
+	Vector3 direction = getDirection();
+	if (count == 0) { return direction.normalisedCopy(); }	//nobody nearby, keep heading
+
+	Vector3 vSeparate = Vector3(sepX, sepY, sepZ) * KSEPERATE;		//sereration velocity
+
+	Vector3 vAlign = Vector3(aliX, aliY, aliZ) / count;
+	vAlign = vAlign - direction;
 	vAlign = vAlign * KALIGN;								//alignment velocity
 
-	xCenterOfMass = xCenterOfMass / count;
-	vCohesion = xCenterOfMass - mBodyNode->getPosition();
+	Vector3 xCenterOfMass = Vector3(comX, comY, comZ) / count;
+	Vector3 vCohesion = xCenterOfMass - Vector3(x, y, z);
 	vCohesion = vCohesion * KCOHESION;						//cohesion velocity
 
-	return mDirection.normalisedCopy()						//
+	return direction.normalisedCopy()						//
 		+ CSEPERATE * vSeparate								//
 		+ CALIGN	* vAlign								//
 		+ CCOHESION	* vCohesion;							//return the flocking velocity
@@ -459,23 +678,19 @@ Agent::vFlock()
 void
 Agent::assimilate()
 {
-	std::list<Agent*>::iterator iter;
-	std::list<Agent*> agentList = mGame->getAgentList();
-	for (iter = agentList.begin(); iter != agentList.end(); iter++)
+	//mNeighbors holds the agents move() found within the neighborhood radius,
+	//so anyone in it is close enough to bring into the fold, I mean flock
+	for (unsigned int i = 0; i < mNeighbors.size(); i++)
 	{
-		if (*iter != NULL && *iter != this)	//don't check agent with itself
-		if (!(*iter)->isFlocking())
+		if (mNeighbors[i] != mSlot)	//don't check agent with itself
+		if (!mFlock->flocking[mNeighbors[i]])
 		{
-			Ogre::Vector3 dist = mBodyNode->getPosition() - (*iter)->mBodyNode->getPosition();
-			Ogre::Real length = dist.length();
-			//check if close, if so, bring agent into the fold, I mean flock
-			if ( length < 50 )	{ (*iter)->mFlocking = true; }
+			mFlock->flocking[mNeighbors[i]] = true;
 		}
 	}
+	mNeighbors.clear();
 }
 
-//TODO:	add a max distance for neighborhoods eventually
-
 //OLD CODE
 // calculate the separation velocity
 // keeps them from running into each other
@@ -1,9 +1,16 @@
-#include "BaseApplication.h"
 #include <deque>
+#include <string>
 
 #pragma once
+#include "SimMath.h"
+#ifndef HEADLESS
+#include "BaseApplication.h"
+#endif
 #include "Grid.h"
-#include "GameApplication.h"
+#include "Simulation.h"
+#include "FlockState.h"
+#include "FlockKernel.h"
+#include "FlowField.h"
 
 #define CSEPERATE 1.0
 #define CALIGN 1.0
@@ -11,19 +18,25 @@
 #define KSEPERATE 0.5
 #define KALIGN 0.5
 #define KCOHESION 0.01
+#define NEIGHBORHOOD 50.0	// default neighborhood radius for flocking and assimilating
+#define FLOCK_RATE 60.0		// the flocking velocity is in units per 1/60 s, the frame rate it was tuned at
 
 //forward declarations -----
 class GridNode;
 class Grid;
-class GameApplication;
+class Simulation;
+class FlockState;
+class DStarLite;
 //--------------------------
 
 class Agent
 {
 private:
+#ifndef HEADLESS
 	Ogre::SceneManager* mSceneMgr;		// pointer to scene graph
 	Ogre::SceneNode* mBodyNode;			
 	Ogre::Entity* mBodyEntity;
+#endif
 	float height;						// height the character should be moved up
 	float scale;						// scale of character from original model
 
@@ -47,9 +60,10 @@ private:
 		ANIM_NONE
 	};
 
-	Ogre::AnimationState* mAnims[13];		// master animation list
 	AnimID mBaseAnimID;						// current base (full- or lower-body) animation
 	AnimID mTopAnimID;						// current top (upper-body) animation
+#ifndef HEADLESS
+	Ogre::AnimationState* mAnims[13];		// master animation list
 	bool mFadingIn[13];						// which animations are fading in
 	bool mFadingOut[13];					// which animations are fading out
 	Ogre::Real mTimer;						// general timer to see how long animations have been playing
@@ -57,52 +71,78 @@ private:
 
 	void setupAnimations();							// load this character's animations
 	void fadeAnimations(Ogre::Real deltaTime);		// blend from one animation to another
-	void updateAnimations(Ogre::Real deltaTime);	// update the animation frame
+#endif
+	void updateAnimations(Real deltaTime);	// update the animation frame (nothing to play in the headless build)
 
 	// for A*
 	Grid* mGrid;							// pointer to the current grid the agent is in
 	GridNode* mGridNode;					// node the agent currently occupies 
 	GridNode* mNextNode;					// destination node
+	GridNode* mFlowGoal;					// goal of the flow field being followed (NULL = not following one)
+	DStarLite* mPlanner;					// incremental plan for planTo, kept for the next goal (NULL until the first)
+	bool mPlanning;							// walking the planner's plan
+	int mPathTicket;						// path service ticket of the path being searched for (0 = not waiting for one)
+	void cancelPath();						// stop waiting for that path
 
 	// for flocking
-	GameApplication* mGame;					// a pointer to the gameapplication, will use for agent list
-	Ogre::Vector3 vFlock();					// calculate the flocking velocity
+	// position, direction, speed and the flocking flag live in the game's FlockState, in slot mSlot
+	Simulation* mGame;						// a pointer to the simulation, will use for agent list
+	FlockState* mFlock;						// the game's boid state
+	int mSlot;								// this agent's slot in mFlock
+	Vector3 vFlock();					// calculate the flocking velocity
 	//Ogre::Vector3 vSeparate();				// calculate the separation velocity
 	//Ogre::Vector3 vAlign();					// calculate the alignment velocity
 	//Ogre::Vector3 vCohesion();				// calculate the cohesion velocity
-	void assimilate();						// bring neighbors into the flock
-	bool mFlocking;							// is the agent flocking with other agents?
+	void assimilate();						// bring the neighbors move() found into the flock
+	std::vector<int> mNeighbors;			// flock slots move() found nearby, assimilated in apply(); reused every frame
+	FlockNeighbors mFlockmates;				// scratch list of packed flockmates for vFlock, reused every frame
 
 	// for locomotion
 	bool mWalking;							// is the agent walking presently?
-	Ogre::Real mDistance;					// The distance the agent has left to travel
-	Ogre::Vector3 mDirection;				// The direction the object is moving
-	Ogre::Vector3 mDestination;				// The destination the object is moving towards
-	std::deque<Ogre::Vector3> mWalkList;	// The list of points we are walking to
-	Ogre::Real mWalkSpeed;					// The speed at which the object is moving
+	bool mMoving;							// should move() translate the agent this frame? set by think()
+	Real mDistance;							// The distance the agent has left to travel
+	Vector3 mDestination;					// The destination the object is moving towards
+	std::deque<Vector3> mWalkList;			// The list of points we are walking to
+	Vector3 getDirection();					// The direction the object is moving
+	void setDirection(const Vector3& dir);
 	bool nextLocation();					// Is there another destination?
-	void updateLocomote(Ogre::Real deltaTime);		// update the character's walking
+	void updateLocomote(Real deltaTime);	// update the character's walking
 	bool procedural;						// Is this character performing a procedural animation
-	void rotate(Ogre::Vector3 towards);		// rotate agent towards goal
+	void rotate(Vector3 towards);			// rotate agent towards goal (no body to turn in the headless build)
 
 public:
-	Agent(GameApplication* game, Ogre::SceneManager* SceneManager, std::string name, std::string filename, float height, float scale);
+#ifdef HEADLESS
+	Agent(Simulation* game, float height, float scale);
+#else
+	Agent(Simulation* game, Ogre::SceneManager* SceneManager, std::string name, std::string filename, float height, float scale);
+#endif
 	~Agent();
 	void setPosition(float x, float y, float z);	//set position by coordinates
+	Vector3 getPosition();							//get the simulated position of the agent
+	void syncNode(Real alpha = 1);					//move the scene node alpha of the way from the last step's position to the current one
 
 	void claimNode(GridNode* n);		//set pointer to current grid node agent is occupying
 	void setGrid(Grid* g);				//set pointer to grid level agent is in
 
-	void update(Ogre::Real deltaTime);		// update the agent
+	void update(Real deltaTime);			// update the agent (think, move and apply in one go)
+	void think(Real deltaTime);				// main thread: animations, arrivals, walk list
+	void move(Real deltaTime);				// any thread: flocking and integration, writes only this agent's slot
+	void apply();							// main thread: assimilate the neighbors move() found
 	
 	void setBaseAnimation(AnimID id, bool reset = false);	// choose animation to display
 	void setTopAnimation(AnimID id, bool reset = false);
 
 	void genWalkList();				// generate a random walk list
 	void walkTo(GridNode* n);		// walk character from current location to destination node
-	void walkTo(Ogre::Vector3 dest);// walk character from current location to destination position
+	void walkTo(Vector3 dest);		// walk character from current location to destination position
 	//void addToWalkList(GridNode* n);	// add destinations to walk list
-	void moveTo(GridNode* n);		// calculate path to destination 
-	bool isFlocking() { return mFlocking; }	//return if agent is flocking
-	void toggleFlocking() { mFlocking = !mFlocking; } //toggle flocking on/off
+	void moveTo(GridNode* n, int priority = PATH_PRIORITY, bool snap = false);	// calculate path to destination, in the background (snap: go as near as possible if it can't be reached)
+	void receivePath(int ticket, const std::deque<GridNode*>& path);	// main thread: the path moveTo asked for
+	GridNode* destinationFor(GridNode* n, bool snap = false);	// where moveTo(n) would search to, NULL if it wouldn't search at all
+	GridNode* getGridNode() { return mGridNode; }	// node the agent is on
+	bool isWaitingForPath() { return mPathTicket != 0; }
+	void followFlow(GridNode* goal);	// walk to goal along the grid's shared flow field
+	void planTo(GridNode* goal);		// walk to goal, replanning as nodes are blocked or cleared on the way
+	bool isFlocking() { return mFlock->flocking[mSlot] != 0; }	//return if agent is flocking
+	void toggleFlocking() { mFlock->flocking[mSlot] = !mFlock->flocking[mSlot]; } //toggle flocking on/off
 };
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "AllocCounter.h"
+#include <cstdlib>
+#include <new>
+#include <atomic>
+
+// replacing the global operator new/delete pair is the only way to see
+// allocations made inside the standard containers.
+// Ogre's own objects go through its allocator and are not counted.
+static std::atomic<unsigned long> allocations(0);
+
+void* 
+operator new(std::size_t size)
+{
+	allocations++;
+	if (size == 0) { size = 1; }
+	void* p = std::malloc(size);
+	if (p == NULL) { throw std::bad_alloc(); }
+	return p;
+}
+
+void* 
+operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void 
+operator delete(void* p) throw()
+{
+	std::free(p);
+}
+
+void 
+operator delete[](void* p) throw()
+{
+	std::free(p);
+}
+
+unsigned long
+getAllocationCount()
+{
+	return allocations;
+}
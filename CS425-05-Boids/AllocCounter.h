@@ -0,0 +1,8 @@
+////////////////////////////////////////////////////////
+// Counts heap allocations made through the global operator new.
+// GameApplication uses it to show how many allocations one
+// simulation update makes (details panel, "Sim Allocs").
+
+#pragma once
+
+unsigned long getAllocationCount();	// number of operator new calls since the program started
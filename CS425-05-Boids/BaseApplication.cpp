@@ -155,6 +155,12 @@ void BaseApplication::createFrameListener(void)
     items.push_back("");
     items.push_back("Filtering");
     items.push_back("Poly Mode");
+    items.push_back("");
+    items.push_back("Sim Allocs");
+    items.push_back("Sim Steps");
+    items.push_back("Path Hits");
+    items.push_back("Path Misses");
+    items.push_back("Path Queue");
 
     mDetailsPanel = mTrayMgr->createParamsPanel(OgreBites::TL_NONE, "DetailsPanel", 200, items);
     mDetailsPanel->setParamValue(9, "Bilinear");
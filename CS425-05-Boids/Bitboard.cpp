@@ -0,0 +1,162 @@
+#include "Bitboard.h"
+#include <cstddef>
+#include <algorithm>
+
+Bitboard::Bitboard()
+{
+	nRows = 0;
+	nCols = 0;
+	rowWords = 0;
+}
+
+void
+Bitboard::resize(int numRows, int numCols)
+{
+	nRows = numRows;
+	nCols = numCols;
+	rowWords = (numCols + 63) / 64;
+	bits.assign(nRows * rowWords, 0);
+	seeds.assign(rowWords, 0);
+}
+
+void
+Bitboard::reset()
+{
+	bits.assign(bits.size(), 0);
+}
+
+// the last word of a row only has nCols % 64 nodes in it (if any less than 64)
+void
+Bitboard::fill()
+{
+	BitWord last = nCols % 64 == 0 ? ~(BitWord)0 : ((BitWord)1 << (nCols % 64)) - 1;
+	for (int r = 0; r < nRows; r++)
+	{
+		BitWord* words = row(r);
+		for (int w = 0; w < rowWords - 1; w++)
+			words[w] = ~(BitWord)0;
+		words[rowWords - 1] = last;
+	}
+}
+
+void
+Bitboard::copyFrom(const BitWord* from)
+{
+	BitWord last = nCols % 64 == 0 ? ~(BitWord)0 : ((BitWord)1 << (nCols % 64)) - 1;
+	for (int r = 0; r < nRows; r++)
+	{
+		BitWord* words = row(r);
+		const BitWord* source = from + r * rowWords;
+		for (int w = 0; w < rowWords; w++)
+			words[w] = source[w];
+		words[rowWords - 1] &= last;
+	}
+}
+
+////////////////////////////////////////////////////////////////
+// Going east (up the bits) adding the seeds to the walkable bits carries
+// through each run from the seed to the run's end: the bits that changed
+// are the run. A carry out of the top of a word means the run goes on in
+// the next word. West there is no adding trick, so the seeds are smeared
+// down 1, 2, 4 .. 32 bits, each time only over bits with that many
+// walkable bits below them (Kogge-Stone), and bit 0 hands on to the
+// word before. Past the seed words only the carries are followed, so a
+// short run costs a word or two however long the row is.
+void
+Bitboard::fillRuns(const BitWord* seed, const BitWord* walkable, BitWord* out, int numWords, int& first, int& last)
+{
+	int changedFirst = numWords;
+	int changedLast = -1;
+	BitWord carry = 0;
+	for (int w = first; w < numWords && (w <= last || carry != 0); w++)
+	{
+		BitWord x = ((w <= last ? seed[w] : 0) | carry) & walkable[w];
+		BitWord sum = walkable[w] + x;
+		BitWord fill = ((sum ^ walkable[w]) & walkable[w]) | x;
+		if (fill & ~out[w])
+		{
+			changedFirst = std::min(changedFirst, w);
+			changedLast = std::max(changedLast, w);
+			out[w] |= fill;
+		}
+		carry = sum < walkable[w] ? 1 : 0;
+	}
+
+	carry = 0;
+	for (int w = last; w >= 0 && (w >= first || carry != 0); w--)
+	{
+		BitWord x = ((w >= first ? seed[w] : 0) | carry) & walkable[w];
+		BitWord g = walkable[w];
+		x |= g & (x >> 1);  g &= g >> 1;
+		x |= g & (x >> 2);  g &= g >> 2;
+		x |= g & (x >> 4);  g &= g >> 4;
+		x |= g & (x >> 8);  g &= g >> 8;
+		x |= g & (x >> 16); g &= g >> 16;
+		x |= g & (x >> 32);
+		if (x & ~out[w])
+		{
+			changedFirst = std::min(changedFirst, w);
+			changedLast = std::max(changedLast, w);
+			out[w] |= x;
+		}
+		carry = (x & 1) << 63;
+	}
+	first = changedFirst;
+	last = changedLast;
+}
+
+////////////////////////////////////////////////////////////////
+// Fill the seed's run, then keep handing rows on: whatever a row gained
+// that the row above (or below) can step into and doesn't have yet seeds
+// runs there, and that row goes on the stack with the words it gained to
+// hand on in turn. Each push is something new, so it ends. The stack is
+// row, first word, last word. The area's bounding box comes back, a
+// connected area's rows being one unbroken span, so the caller only has
+// to look in there.
+void
+Bitboard::flood(int seed, const Bitboard& walkable, std::vector<int>& rowStack, int& firstRow, int& lastRow, int& firstWord, int& lastWord)
+{
+	int r = seed / nCols;
+	int lo = seed % nCols / 64;
+	int hi = lo;
+	seeds[lo] = (BitWord)1 << (seed % nCols % 64);
+	fillRuns(&seeds[0], walkable.row(r), row(r), rowWords, lo, hi);
+	firstRow = r;
+	lastRow = r;
+	firstWord = lo;
+	lastWord = hi;
+	rowStack.push_back(r);
+	rowStack.push_back(lo);
+	rowStack.push_back(hi);
+
+	while (!rowStack.empty())
+	{
+		hi = rowStack.back(); rowStack.pop_back();
+		lo = rowStack.back(); rowStack.pop_back();
+		r = rowStack.back(); rowStack.pop_back();
+		for (int next = r - 1; next <= r + 1; next += 2)
+		{
+			if (next < 0 || next >= nRows) { continue; }
+			const BitWord* from = row(r);
+			const BitWord* walk = walkable.row(next);
+			BitWord* to = row(next);
+			BitWord any = 0;
+			for (int w = lo; w <= hi; w++)
+			{
+				seeds[w] = from[w] & walk[w] & ~to[w];
+				any |= seeds[w];
+			}
+			if (any == 0) { continue; }
+			int first = lo;
+			int last = hi;
+			fillRuns(&seeds[0], walk, to, rowWords, first, last);
+			rowStack.push_back(next);
+			rowStack.push_back(first);
+			rowStack.push_back(last);
+			firstRow = std::min(firstRow, next);
+			lastRow = std::max(lastRow, next);
+			firstWord = std::min(firstWord, first);
+			lastWord = std::max(lastWord, last);
+		}
+	}
+}
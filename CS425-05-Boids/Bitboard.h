@@ -0,0 +1,70 @@
+////////////////////////////////////////////////////////////////
+// One bit per grid node, 64 nodes to a word
+// Each row starts on a new word and the bits past the last column are
+// always 0, so a row is a little array of words and whole rows can be
+// ANDed and ORed a word at a time instead of a node at a time (loops
+// plain enough for the compiler to widen to SSE/AVX).
+// flood() fills the area a node is in a wavefront of rows at a time.
+// Reachability doesn't need the diagonals: a diagonal move is only
+// allowed when both nodes beside it are clear, so the two straight moves
+// get there too, and the flood is just runs filled along a row
+// (fillRuns, a whole run in a couple of word operations) and handed on
+// to the rows above and below.
+
+#pragma once
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+typedef unsigned long long BitWord;
+
+// index of the lowest set bit, w must not be 0
+inline int
+lowestBit(BitWord w)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long i;
+	_BitScanForward64(&i, w);
+	return (int)i;
+#elif defined(_MSC_VER)
+	unsigned long i;
+	if (_BitScanForward(&i, (unsigned long)w)) { return (int)i; }
+	_BitScanForward(&i, (unsigned long)(w >> 32));
+	return (int)i + 32;
+#else
+	return __builtin_ctzll(w);
+#endif
+}
+
+class Bitboard
+{
+private:
+	int nRows;
+	int nCols;
+	int rowWords;					// words per row
+	std::vector<BitWord> bits;		// row by row
+	std::vector<BitWord> seeds;		// scratch for flood, one row
+
+public:
+	Bitboard();
+
+	void resize(int numRows, int numCols);	// every bit 0
+	void reset();							// every bit 0, same size
+	void fill();							// every node's bit 1
+	void copyFrom(const BitWord* from);		// rows laid out the same as here (LevelFile), padding left 0 whatever from has there
+	int getNumRows() const { return nRows; }
+	int getNumCols() const { return nCols; }
+	int getRowWords() const { return rowWords; }
+
+	// by node ID, row * columns + column
+	bool test(int id) const { return (bits[wordOf(id)] >> (id % nCols % 64)) & 1; }
+	void set(int id) { bits[wordOf(id)] |= (BitWord)1 << (id % nCols % 64); }
+	void clear(int id) { bits[wordOf(id)] &= ~((BitWord)1 << (id % nCols % 64)); }
+	int wordOf(int id) const { return id / nCols * rowWords + id % nCols / 64; }
+	BitWord* row(int r) { return &bits[r * rowWords]; }
+	const BitWord* row(int r) const { return &bits[r * rowWords]; }
+
+	static void fillRuns(const BitWord* seed, const BitWord* walkable, BitWord* out, int numWords, int& first, int& last);	// out |= the walkable runs holding a seed in words first to last; gives back the words out changed in
+	void flood(int seed, const Bitboard& walkable, std::vector<int>& rowStack, int& firstRow, int& lastRow, int& firstWord, int& lastWord);	// set every node seed can reach and give back where they are, the seed must be walkable and its bit 0
+};
@@ -0,0 +1,260 @@
+#include "DStarLite.h"
+#include <cmath>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+
+#define DSTAR_INFINITY (INT_MAX / 4)	// no way to the goal, still safe to add a move cost to
+
+static const int diagonal_cost = sqrt(NODESIZE * NODESIZE + NODESIZE * NODESIZE);
+// {North,South,East,West,NE,NW,SE,SW}, same order as getAllNeighbors
+static const int dirRow[8] = { -1, 1, 0, 0, -1, -1, 1, 1 };
+static const int dirCol[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+
+DStarLite::DStarLite()
+{
+	grid = NULL;
+	start = -1;
+	goal = -1;
+	last = -1;
+	km = 0;
+	revision = 0;
+	reader = -1;
+	expansions = 0;
+}
+
+DStarLite::~DStarLite()
+{
+	if (reader != -1)
+		grid->unfollowChanges(reader);
+}
+
+////////////////////////////////////////////////////////////////
+// std::push_heap keeps the entry that comes after nothing on top,
+// the lowest key, compared k1 first
+bool
+DStarLite::comesAfter(const Entry& a, const Entry& b)
+{
+	if (a.k1 != b.k1) { return a.k1 > b.k1; }
+	return a.k2 > b.k2;
+}
+
+int
+DStarLite::estimate(int a, int b)
+{
+	int dR = std::abs(a / grid->getNumCols() - b / grid->getNumCols());
+	int dC = std::abs(a % grid->getNumCols() - b % grid->getNumCols());
+	return (int)NODESIZE * std::max(dR, dC) + (diagonal_cost - (int)NODESIZE) * std::min(dR, dC);
+}
+
+const DStarLite::Costs&
+DStarLite::costsOf(int node)
+{
+	static const Costs unreached = { DSTAR_INFINITY, DSTAR_INFINITY };
+	std::unordered_map<int, Costs>::iterator found = costs.find(node);
+	return found == costs.end() ? unreached : found->second;
+}
+
+////////////////////////////////////////////////////////////////
+// the grid's move masks decide which moves are allowed (walkable,
+// and no cutting corners), so the plan can never disagree with aStar
+int
+DStarLite::moveCost(GridNode* from, int i)
+{
+	if (!(grid->getMoves(from->getID()) & (1 << i))) { return -1; }
+	return i < 4 ? (int)NODESIZE : diagonal_cost;
+}
+
+DStarLite::Entry
+DStarLite::keyOf(int node)
+{
+	Entry e;
+	const Costs& c = costsOf(node);
+	e.k2 = std::min(c.g, c.rhs);
+	e.k1 = e.k2 >= DSTAR_INFINITY ? DSTAR_INFINITY : e.k2 + estimate(start, node) + km;
+	e.node = node;
+	return e;
+}
+
+void
+DStarLite::push(int node)
+{
+	open.push_back(keyOf(node));
+	std::push_heap(open.begin(), open.end(), comesAfter);
+}
+
+////////////////////////////////////////////////////////////////
+// a blocked node has no way anywhere. Moves are the same both ways, so
+// the neighbors of a node are also the nodes that can step onto it.
+// A node still out of reach isn't added, it is consistent as it is
+void
+DStarLite::updateNode(int node)
+{
+	std::unordered_map<int, Costs>::iterator found = costs.find(node);
+	if (node != goal)
+	{
+		GridNode* n = grid->getNodeByID(node);
+		int best = DSTAR_INFINITY;
+		if (n->isClear())
+			for (int i = 0; i < 8; i++)
+			{
+				int cost = moveCost(n, i);
+				if (cost == -1) { continue; }
+				best = std::min(best, costsOf(node + grid->getMoveOffset(i)).g + cost);
+			}
+		best = std::min(best, (int)DSTAR_INFINITY);
+		if (found == costs.end())
+		{
+			if (best == DSTAR_INFINITY) { return; }
+			Costs c = { DSTAR_INFINITY, best };
+			found = costs.insert(std::make_pair(node, c)).first;
+		}
+		found->second.rhs = best;
+	}
+	if (found != costs.end() && found->second.g != found->second.rhs)
+		push(node);	//any older entry for it is skipped or requeued when it comes up
+}
+
+////////////////////////////////////////////////////////////////
+// expand the lowest key until the start is settled and nothing on the
+// open list could still make it cheaper
+void
+DStarLite::computePath()
+{
+	while (!open.empty())
+	{
+		Entry top = open.front();
+		if (costsOf(top.node).g == costsOf(top.node).rhs)	// fixed since it was queued
+		{
+			std::pop_heap(open.begin(), open.end(), comesAfter);
+			open.pop_back();
+			continue;
+		}
+		Entry startKey = keyOf(start);
+		if (!comesAfter(startKey, top) && costsOf(start).rhs == costsOf(start).g) { break; }	// top isn't lower than the start's key
+
+		std::pop_heap(open.begin(), open.end(), comesAfter);
+		open.pop_back();
+		Entry now = keyOf(top.node);
+		if (comesAfter(now, top))	// the start moved since it was queued
+		{
+			open.push_back(now);
+			std::push_heap(open.begin(), open.end(), comesAfter);
+			continue;
+		}
+
+		expansions++;
+		int u = top.node;
+		GridNode* n = grid->getNodeByID(u);
+		Costs& c = costs[u];	// it was queued, so it is in there
+		bool overconsistent = c.g > c.rhs;
+		c.g = overconsistent ? c.rhs : (int)DSTAR_INFINITY;
+		if (!overconsistent) { updateNode(u); }
+		for (int i = 0; i < 8; i++)
+		{
+			int row = n->getRow() + dirRow[i];
+			int col = n->getColumn() + dirCol[i];
+			if (row < 0 || col < 0 || row >= grid->getNumRows() || col >= grid->getNumCols()) { continue; }
+			updateNode(row * grid->getNumCols() + col);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////
+// the agent is on node now. Moving the start lowers every key still
+// queued by at most the distance it moved, so adding that to km keeps
+// them lower bounds and none has to be recomputed.
+// A change to a node's walkability changes the moves in and out of it,
+// and the diagonal moves that cut its corner, so the nodes in the 3x3
+// block around it are all that need their rhs looked at again
+void
+DStarLite::refresh(int node)
+{
+	start = node;
+	km += estimate(last, start);
+	last = start;
+	for (revision++; revision <= grid->getRevision(); revision++)
+	{
+		int changed = grid->getChangedNode(revision);
+		int row = changed / grid->getNumCols();
+		int col = changed % grid->getNumCols();
+		for (int r = row - 1; r <= row + 1; r++)
+			for (int c = col - 1; c <= col + 1; c++)
+				if (r >= 0 && c >= 0 && r < grid->getNumRows() && c < grid->getNumCols())
+					updateNode(r * grid->getNumCols() + c);
+	}
+	revision = grid->getRevision();
+	grid->caughtUp(reader, revision);
+	computePath();
+}
+
+////////////////////////////////////////////////////////////////
+// set up and search from scratch. The map and open list keep their room
+// between goals. A planner moved to another grid doesn't let go of the
+// old one's log, Simulation::setGrid has deleted that grid by then
+void
+DStarLite::begin(Grid* gr, GridNode* startNode, GridNode* goalNode)
+{
+	if (grid != gr)
+		reader = -1;
+	grid = gr;
+	costs.clear();
+	open.clear();
+	km = 0;
+	expansions = 0;
+	revision = grid->getRevision();
+	if (reader == -1)
+		reader = grid->followChanges();
+	grid->caughtUp(reader, revision);
+	start = last = startNode->getID();
+	goal = goalNode->getID();
+	if (!goalNode->isClear()) { return; }
+
+	Costs c = { DSTAR_INFINITY, 0 };
+	costs[goal] = c;
+	push(goal);
+	computePath();
+}
+
+////////////////////////////////////////////////////////////////
+// the agent is on current: bring the plan up to date and pick the
+// neighbor with the cheapest way on to the goal
+GridNode*
+DStarLite::getNext(GridNode* current)
+{
+	if (grid == NULL || current == NULL) { return NULL; }
+	refresh(current->getID());
+	if (start == goal || costsOf(start).g >= DSTAR_INFINITY) { return NULL; }
+
+	GridNode* next = NULL;
+	int best = DSTAR_INFINITY;
+	for (int i = 0; i < 8; i++)
+	{
+		int cost = moveCost(current, i);
+		if (cost == -1) { continue; }
+		int id = current->getID() + grid->getMoveOffset(i);
+		int through = costsOf(id).g + cost;
+		if (through < best)
+		{
+			best = through;
+			next = grid->getNodeByID(id);
+		}
+	}
+	return next;
+}
+
+GridNode*
+DStarLite::getGoal()
+{
+	if (grid == NULL || goal == -1) { return NULL; }
+	return grid->getNodeByID(goal);
+}
+
+int
+DStarLite::getCost(GridNode* n)
+{
+	if (grid == NULL || n == NULL) { return -1; }
+	refresh(n->getID());
+	int cost = costsOf(start).g;
+	return cost >= DSTAR_INFINITY ? -1 : cost;
+}
@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////
+// Incremental replanning (D* Lite) for one agent's trip to a goal
+// The plan is searched backwards from the goal, so as the agent walks
+// only the start moves and the work already done stays good. When nodes
+// are blocked or cleared (the grid logs every change) only the nodes
+// around them are looked at again, and the search repairs the plan from
+// there instead of starting over.
+// Every agent can have one, so the costs are only kept for the nodes the
+// search has reached (a hash map by node ID), not a table of the whole
+// grid, and each planner is a reader of the grid's change log so the log
+// only keeps the changes some planner hasn't taken in yet.
+// Koenig and Likhachev, "D* Lite", AAAI 2002 (the optimized version).
+
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include "Grid.h"
+
+class DStarLite
+{
+private:
+	struct Entry {			// open list entry, see comesAfter()
+		int k1, k2;			// key: min(g, rhs) + estimate from the start + km, then min(g, rhs)
+		int node;
+	};
+	struct Costs {
+		int g;				// cost to the goal as of the last expansion
+		int rhs;			// cost to the goal through the best neighbor
+	};
+
+	Grid* grid;
+	int start;				// node ID the agent is on
+	int goal;
+	int last;				// start when km was last brought up to date
+	int km;					// how far the start has moved since the search began, keeps old keys good
+	int revision;			// grid revision the plan has seen the changes up to
+	int reader;				// its reader of the grid's change log (-1 = none)
+	std::unordered_map<int, Costs> costs;	// by node ID, a node not in it hasn't been reached (both infinite)
+	std::vector<Entry> open;	// heap, entries for nodes that have been fixed since are skipped when they come up
+	int expansions;			// nodes expanded since begin()
+
+	static bool comesAfter(const Entry& a, const Entry& b);	// heap ordering
+	int estimate(int a, int b);		// octile distance
+	const Costs& costsOf(int node);	// infinite if the search hasn't reached it
+	int moveCost(GridNode* from, int i);	// cost of the move from from in direction i (getAllNeighbors order), -1 if it can't be made
+	Entry keyOf(int node);
+	void push(int node);
+	void updateNode(int node);		// recompute rhs from the neighbors, queue the node if it is now inconsistent
+	void computePath();				// expand until the start's cost is settled
+	void refresh(int node);			// the agent is on node: take in the grid's changes since the last look and repair the plan
+
+public:
+	DStarLite();
+	~DStarLite();
+
+	void begin(Grid* gr, GridNode* startNode, GridNode* goalNode);	// plan from scratch
+	GridNode* getNext(GridNode* current);	// node to step to from current (repairing the plan first if the grid changed), NULL at the goal or if it can't be reached
+	GridNode* getGoal();
+	int getCost(GridNode* n);				// cost from n to the goal as planned (n becomes the start), -1 if it can't be reached
+	int getExpansions() { return expansions; }
+};
@@ -0,0 +1,378 @@
+#include "FlockKernel.h"
+#include "FlockState.h"
+#include "SpatialHash.h"
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+
+// SIMD kernels are only built for x86, anything else gets the scalar one
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define FLOCK_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define FLOCK_TARGET_SSE
+#define FLOCK_TARGET_AVX2
+#else
+#define FLOCK_TARGET_SSE __attribute__((target("sse")))
+#define FLOCK_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+////////////////////////////////////////////////////////////////
+// append one neighbor, growing the arrays only when the crowd gets bigger
+void
+FlockNeighbors::add(float x, float y, float z, float dx, float dy, float dz)
+{
+	if (count == (int)posX.size())
+	{
+		int size = std::max(16, 2 * count);
+		posX.resize(size); posY.resize(size); posZ.resize(size);
+		dirX.resize(size); dirY.resize(size); dirZ.resize(size);
+	}
+	posX[count] = x; posY[count] = y; posZ[count] = z;
+	dirX[count] = dx; dirY[count] = dy; dirZ[count] = dz;
+	count++;
+}
+
+////////////////////////////////////////////////////////////////
+// add neighbors [first, count) one at a time. used by the scalar kernel
+// and for the leftovers the vector kernels can't fill a register with
+static void 
+sumRange(float x, float y, float z, const FlockNeighbors& n, int first, FlockSums& sums)
+{
+	for (int i = first; i < n.count; i++)
+	{
+		float dx = x - n.posX[i], dy = y - n.posY[i], dz = z - n.posZ[i];
+		float inv = 1.0f / (dx * dx + dy * dy + dz * dz);
+		sums.sepX += dx * inv;
+		sums.sepY += dy * inv;
+		sums.sepZ += dz * inv;
+		sums.aliX += n.dirX[i];
+		sums.aliY += n.dirY[i];
+		sums.aliZ += n.dirZ[i];
+		sums.comX += n.posX[i];
+		sums.comY += n.posY[i];
+		sums.comZ += n.posZ[i];
+	}
+}
+
+static void 
+clearSums(FlockSums& sums, int count)
+{
+	sums.sepX = sums.sepY = sums.sepZ = 0;
+	sums.aliX = sums.aliY = sums.aliZ = 0;
+	sums.comX = sums.comY = sums.comZ = 0;
+	sums.count = count;
+}
+
+void 
+flockSumsScalar(float x, float y, float z, const FlockNeighbors& neighbors, FlockSums& sums)
+{
+	clearSums(sums, neighbors.count);
+	sumRange(x, y, z, neighbors, 0, sums);
+}
+
+#ifdef FLOCK_X86
+FLOCK_TARGET_SSE static float 
+hsum(__m128 v)
+{
+	float lanes[4];
+	_mm_storeu_ps(lanes, v);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+////////////////////////////////////////////////////////////////
+// 4 neighbors per step
+FLOCK_TARGET_SSE void 
+flockSumsSSE(float x, float y, float z, const FlockNeighbors& n, FlockSums& sums)
+{
+	clearSums(sums, n.count);
+	if (n.count == 0) { return; }
+
+	const float* posX = &n.posX[0];
+	const float* posY = &n.posY[0];
+	const float* posZ = &n.posZ[0];
+	const float* dirX = &n.dirX[0];
+	const float* dirY = &n.dirY[0];
+	const float* dirZ = &n.dirZ[0];
+
+	__m128 sx = _mm_set1_ps(x), sy = _mm_set1_ps(y), sz = _mm_set1_ps(z);
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 sepX = _mm_setzero_ps(), sepY = _mm_setzero_ps(), sepZ = _mm_setzero_ps();
+	__m128 aliX = _mm_setzero_ps(), aliY = _mm_setzero_ps(), aliZ = _mm_setzero_ps();
+	__m128 comX = _mm_setzero_ps(), comY = _mm_setzero_ps(), comZ = _mm_setzero_ps();
+
+	int i = 0;
+	for (; i + 4 <= n.count; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(posX + i), py = _mm_loadu_ps(posY + i), pz = _mm_loadu_ps(posZ + i);
+
+		__m128 dx = _mm_sub_ps(sx, px), dy = _mm_sub_ps(sy, py), dz = _mm_sub_ps(sz, pz);
+		__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		__m128 inv = _mm_div_ps(one, lengthSq);
+		sepX = _mm_add_ps(sepX, _mm_mul_ps(dx, inv));
+		sepY = _mm_add_ps(sepY, _mm_mul_ps(dy, inv));
+		sepZ = _mm_add_ps(sepZ, _mm_mul_ps(dz, inv));
+
+		aliX = _mm_add_ps(aliX, _mm_loadu_ps(dirX + i));
+		aliY = _mm_add_ps(aliY, _mm_loadu_ps(dirY + i));
+		aliZ = _mm_add_ps(aliZ, _mm_loadu_ps(dirZ + i));
+
+		comX = _mm_add_ps(comX, px);
+		comY = _mm_add_ps(comY, py);
+		comZ = _mm_add_ps(comZ, pz);
+	}
+	sums.sepX = hsum(sepX); sums.sepY = hsum(sepY); sums.sepZ = hsum(sepZ);
+	sums.aliX = hsum(aliX); sums.aliY = hsum(aliY); sums.aliZ = hsum(aliZ);
+	sums.comX = hsum(comX); sums.comY = hsum(comY); sums.comZ = hsum(comZ);
+	sumRange(x, y, z, n, i, sums);	// leftovers
+}
+
+FLOCK_TARGET_AVX2 static float 
+hsum(__m256 v)
+{
+	float lanes[8];
+	_mm256_storeu_ps(lanes, v);
+	return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+////////////////////////////////////////////////////////////////
+// 8 neighbors per step. The leftovers go through a masked load instead of
+// sumRange(): calling non-AVX code with the upper halves of the registers
+// dirty costs more than the whole kernel.
+FLOCK_TARGET_AVX2 void 
+flockSumsAVX2(float x, float y, float z, const FlockNeighbors& n, FlockSums& sums)
+{
+	clearSums(sums, n.count);
+	if (n.count == 0) { return; }
+
+	const float* posX = &n.posX[0];
+	const float* posY = &n.posY[0];
+	const float* posZ = &n.posZ[0];
+	const float* dirX = &n.dirX[0];
+	const float* dirY = &n.dirY[0];
+	const float* dirZ = &n.dirZ[0];
+
+	__m256 sx = _mm256_set1_ps(x), sy = _mm256_set1_ps(y), sz = _mm256_set1_ps(z);
+	__m256 one = _mm256_set1_ps(1.0f);
+	__m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256 sepX = _mm256_setzero_ps(), sepY = _mm256_setzero_ps(), sepZ = _mm256_setzero_ps();
+	__m256 aliX = _mm256_setzero_ps(), aliY = _mm256_setzero_ps(), aliZ = _mm256_setzero_ps();
+	__m256 comX = _mm256_setzero_ps(), comY = _mm256_setzero_ps(), comZ = _mm256_setzero_ps();
+
+	for (int i = 0; i < n.count; i += 8)
+	{
+		// lanes past the last neighbor load as zero and are masked out of the separation
+		__m256i lanes = _mm256_cmpgt_epi32(_mm256_set1_epi32(n.count - i), laneIndex);
+		__m256 px = _mm256_maskload_ps(posX + i, lanes);
+		__m256 py = _mm256_maskload_ps(posY + i, lanes);
+		__m256 pz = _mm256_maskload_ps(posZ + i, lanes);
+
+		__m256 dx = _mm256_sub_ps(sx, px), dy = _mm256_sub_ps(sy, py), dz = _mm256_sub_ps(sz, pz);
+		__m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+		__m256 inv = _mm256_and_ps(_mm256_div_ps(one, lengthSq), _mm256_castsi256_ps(lanes));
+		sepX = _mm256_add_ps(sepX, _mm256_mul_ps(dx, inv));
+		sepY = _mm256_add_ps(sepY, _mm256_mul_ps(dy, inv));
+		sepZ = _mm256_add_ps(sepZ, _mm256_mul_ps(dz, inv));
+
+		aliX = _mm256_add_ps(aliX, _mm256_maskload_ps(dirX + i, lanes));
+		aliY = _mm256_add_ps(aliY, _mm256_maskload_ps(dirY + i, lanes));
+		aliZ = _mm256_add_ps(aliZ, _mm256_maskload_ps(dirZ + i, lanes));
+
+		comX = _mm256_add_ps(comX, px);
+		comY = _mm256_add_ps(comY, py);
+		comZ = _mm256_add_ps(comZ, pz);
+	}
+	sums.sepX = hsum(sepX); sums.sepY = hsum(sepY); sums.sepZ = hsum(sepZ);
+	sums.aliX = hsum(aliX); sums.aliY = hsum(aliY); sums.aliZ = hsum(aliZ);
+	sums.comX = hsum(comX); sums.comY = hsum(comY); sums.comZ = hsum(comZ);
+	_mm256_zeroupper();
+}
+#else
+// no SIMD on this platform, the "vector" kernels are the scalar one
+void 
+flockSumsSSE(float x, float y, float z, const FlockNeighbors& neighbors, FlockSums& sums)
+{
+	flockSumsScalar(x, y, z, neighbors, sums);
+}
+
+void 
+flockSumsAVX2(float x, float y, float z, const FlockNeighbors& neighbors, FlockSums& sums)
+{
+	flockSumsScalar(x, y, z, neighbors, sums);
+}
+#endif
+
+////////////////////////////////////////////////////////////////
+// CPU feature detection
+static bool 
+cpuHasSSE()
+{
+#if !defined(FLOCK_X86)
+	return false;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 25)) != 0;
+#else
+	return __builtin_cpu_supports("sse") != 0;
+#endif
+}
+
+static bool 
+cpuHasAVX2()
+{
+#if !defined(FLOCK_X86)
+	return false;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) { return false; }
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx) { return false; }
+	if ((_xgetbv(0) & 6) != 6) { return false; }	// OS saves the YMM registers
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+static FlockKernel bestKernel = NULL;
+static const char* bestKernelName = "";
+
+static void 
+pickKernel()
+{
+	if (cpuHasAVX2())	  { bestKernel = flockSumsAVX2; bestKernelName = "AVX2"; }
+	else if (cpuHasSSE()) { bestKernel = flockSumsSSE; bestKernelName = "SSE"; }
+	else				  { bestKernel = flockSumsScalar; bestKernelName = "scalar"; }
+}
+
+FlockKernel 
+getFlockKernel()
+{
+	if (bestKernel == NULL) { pickKernel(); }
+	return bestKernel;
+}
+
+const char* 
+getFlockKernelName()
+{
+	if (bestKernel == NULL) { pickKernel(); }
+	return bestKernelName;
+}
+
+////////////////////////////////////////////////////////////////
+// benchmark: n flocking boids scattered at a crowd's density (about 30
+// flockmates within the 50 unit neighborhood). Each kernel is checked against
+// the scalar sums, then timed twice: on flockmate lists gathered up front
+// (kernel only), and gathering from the hash every time (what vFlock does).
+static float 
+sumsError(const FlockSums& a, const FlockSums& b)
+{
+	float worst = 0;
+	const float* pa = &a.sepX;
+	const float* pb = &b.sepX;
+	for (int k = 0; k < 9; k++)
+	{
+		float scale = std::max(1.0f, std::fabs(pb[k]));
+		worst = std::max(worst, std::fabs(pa[k] - pb[k]) / scale);
+	}
+	return worst;
+}
+
+void 
+benchmarkFlockKernels(std::ostream& out)
+{
+	const float radius = 50.0f;
+	const float density = 30.0f / (3.14159f * radius * radius);	// boids per square unit
+
+	FlockKernel kernels[3] = { flockSumsScalar, flockSumsSSE, flockSumsAVX2 };
+	const char* names[3] = { "scalar", "SSE", "AVX2" };
+	bool supported[3] = { true, cpuHasSSE(), cpuHasAVX2() };
+
+	out << "flocking kernel benchmark (selected: " << getFlockKernelName() << ")" << std::endl;
+
+	int sizes[3] = { 1000, 10000, 100000 };
+	for (int s = 0; s < 3; s++)
+	{
+		int n = sizes[s];
+		float side = std::sqrt(n / density);
+
+		FlockState flock;
+		srand(425);
+		for (int i = 0; i < n; i++)
+		{
+			int slot = flock.add(Vector3(side * rand() / RAND_MAX, 0, side * rand() / RAND_MAX), 25.0f);
+			float angle = 6.28318f * rand() / RAND_MAX;
+			flock.setDirection(slot, Vector3(std::cos(angle), 0, std::sin(angle)));
+			flock.flocking[slot] = true;
+		}
+		SpatialHash hash(radius);
+		hash.build(flock);
+
+		// every boid's flockmates, and the scalar sums to check against
+		std::vector<FlockNeighbors> gathered(n);
+		std::vector<FlockSums> reference(n);
+		long long totalNeighbors = 0;
+		for (int i = 0; i < n; i++)
+		{
+			hash.gatherFlockmates(i, flock.posX[i], flock.posY[i], flock.posZ[i], radius, gathered[i]);
+			flockSumsScalar(flock.posX[i], flock.posY[i], flock.posZ[i], gathered[i], reference[i]);
+			totalNeighbors += gathered[i].count;
+		}
+
+		int passes = std::max(1, 2000000 / n);	// about the same amount of work at every size
+		out << "  " << n << " boids, " << (double)totalNeighbors / n << " flockmates each:" << std::endl;
+		for (int k = 0; k < 3; k++)
+		{
+			if (!supported[k]) 
+			{
+				out << "    " << names[k] << ": not supported" << std::endl;
+				continue;
+			}
+
+			FlockSums sums;
+			float worst = 0;
+			for (int i = 0; i < n; i++)
+			{
+				kernels[k](flock.posX[i], flock.posY[i], flock.posZ[i], gathered[i], sums);
+				worst = std::max(worst, sumsError(sums, reference[i]));
+			}
+
+			float checksum = 0;	// keeps the optimizer from dropping the loops
+			std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+			for (int p = 0; p < passes; p++)
+			{
+				for (int i = 0; i < n; i++)
+				{
+					kernels[k](flock.posX[i], flock.posY[i], flock.posZ[i], gathered[i], sums);
+					checksum += sums.sepX;
+				}
+			}
+			double kernelSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count();
+
+			FlockNeighbors neighbors;
+			t0 = std::chrono::high_resolution_clock::now();
+			for (int p = 0; p < passes / 4 + 1; p++)
+			{
+				for (int i = 0; i < n; i++)
+				{
+					hash.gatherFlockmates(i, flock.posX[i], flock.posY[i], flock.posZ[i], radius, neighbors);
+					kernels[k](flock.posX[i], flock.posY[i], flock.posZ[i], neighbors, sums);
+					checksum += sums.sepX;
+				}
+			}
+			double stepSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count();
+
+			out << "    " << names[k] << ": kernel " << (long long)(n * (double)passes / kernelSeconds) << " agents/s"
+				<< ", gather+kernel " << (long long)(n * (double)(passes / 4 + 1) / stepSeconds) << " agents/s"
+				<< ", max relative error " << worst << (checksum == 0.5f ? " " : "") << std::endl;
+		}
+	}
+}
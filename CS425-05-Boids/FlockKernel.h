@@ -0,0 +1,37 @@
+////////////////////////////////////////////////////////
+// Per-neighbor sums for flocking (separation, alignment, center of mass)
+// Scalar, SSE and AVX2 versions; the fastest one the CPU supports is
+// picked the first time getFlockKernel() is called.
+
+#pragma once
+#include <iostream>
+#include <vector>
+
+struct FlockNeighbors {		// flockmates of one boid, packed so the kernels can load them a vector at a time
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> dirX, dirY, dirZ;
+	int count;
+
+	FlockNeighbors() : count(0) {};
+	void clear() { count = 0; }		// keeps the capacity
+	void add(float x, float y, float z, float dx, float dy, float dz);
+};
+
+struct FlockSums {
+	float sepX, sepY, sepZ;		// sum of (self - other) / |self - other|^2
+	float aliX, aliY, aliZ;		// sum of the others' directions
+	float comX, comY, comZ;		// sum of the others' positions
+	int count;					// number of neighbors summed
+};
+
+// sum over the neighbors of a boid at (x,y,z)
+typedef void (*FlockKernel)(float x, float y, float z, const FlockNeighbors& neighbors, FlockSums& sums);
+
+void flockSumsScalar(float x, float y, float z, const FlockNeighbors& neighbors, FlockSums& sums);
+void flockSumsSSE(float x, float y, float z, const FlockNeighbors& neighbors, FlockSums& sums);
+void flockSumsAVX2(float x, float y, float z, const FlockNeighbors& neighbors, FlockSums& sums);
+
+FlockKernel getFlockKernel();		// best kernel for this CPU
+const char* getFlockKernelName();	// name of the kernel getFlockKernel() returns
+
+void benchmarkFlockKernels(std::ostream& out);	// agents/second for every supported kernel at 1k, 10k and 100k boids
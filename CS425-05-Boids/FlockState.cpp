@@ -0,0 +1,84 @@
+#include "FlockState.h"
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////
+// create an empty flock
+FlockState::FlockState()
+{}
+
+FlockState::~FlockState()
+{}
+
+////////////////////////////////////////////////////////////////
+// add a boid standing at pos, return the slot it was given
+int
+FlockState::add(const Vector3& pos, float walkSpeed)
+{
+	posX.push_back(pos.x);
+	posY.push_back(pos.y);
+	posZ.push_back(pos.z);
+	prevX.push_back(pos.x);
+	prevY.push_back(pos.y);
+	prevZ.push_back(pos.z);
+	dirX.push_back(0);
+	dirY.push_back(0);
+	dirZ.push_back(0);
+	speed.push_back(walkSpeed);
+	flocking.push_back(false);
+	return posX.size() - 1;
+}
+
+Vector3
+FlockState::getPosition(int slot)
+{
+	return Vector3(posX[slot], posY[slot], posZ[slot]);
+}
+
+void
+FlockState::setPosition(int slot, const Vector3& pos)
+{
+	posX[slot] = pos.x;
+	posY[slot] = pos.y;
+	posZ[slot] = pos.z;
+}
+
+void
+FlockState::place(int slot, const Vector3& pos)
+{
+	setPosition(slot, pos);
+	prevX[slot] = pos.x;
+	prevY[slot] = pos.y;
+	prevZ[slot] = pos.z;
+}
+
+Vector3
+FlockState::getDrawPosition(int slot, float alpha)
+{
+	return Vector3(prevX[slot] + (posX[slot] - prevX[slot]) * alpha,
+		prevY[slot] + (posY[slot] - prevY[slot]) * alpha,
+		prevZ[slot] + (posZ[slot] - prevZ[slot]) * alpha);
+}
+
+////////////////////////////////////////////////////////////////
+// called at the start of every step, before anything moves
+void
+FlockState::savePositions()
+{
+	std::copy(posX.begin(), posX.end(), prevX.begin());
+	std::copy(posY.begin(), posY.end(), prevY.begin());
+	std::copy(posZ.begin(), posZ.end(), prevZ.begin());
+}
+
+Vector3
+FlockState::getDirection(int slot)
+{
+	return Vector3(dirX[slot], dirY[slot], dirZ[slot]);
+}
+
+void
+FlockState::setDirection(int slot, const Vector3& dir)
+{
+	dirX[slot] = dir.x;
+	dirY[slot] = dir.y;
+	dirZ[slot] = dir.z;
+}
@@ -0,0 +1,39 @@
+////////////////////////////////////////////////////////
+// Boid simulation state kept as parallel arrays, one slot per agent.
+// The simulation reads and writes these arrays; scene nodes are only
+// updated from them once per frame (Simulation::syncNodes), drawn
+// part way between the previous and the current step.
+
+#pragma once
+#include <vector>
+#include "SimMath.h"
+
+class FlockState
+{
+public:
+	std::vector<float> posX;		// position
+	std::vector<float> posY;
+	std::vector<float> posZ;
+	std::vector<float> prevX;		// position at the start of the last step, for drawing between steps
+	std::vector<float> prevY;
+	std::vector<float> prevZ;
+	std::vector<float> dirX;		// direction of travel, unit length or zero when standing
+	std::vector<float> dirY;
+	std::vector<float> dirZ;
+	std::vector<float> speed;		// walk speed
+	std::vector<char> flocking;		// is the boid flocking with the others? (char, so no vector<bool> packing)
+
+	FlockState();
+	~FlockState();
+
+	int add(const Vector3& pos, float walkSpeed);	// add a boid, returns its slot
+	int size() { return posX.size(); }					// number of boids
+
+	Vector3 getPosition(int slot);
+	void setPosition(int slot, const Vector3& pos);
+	void place(int slot, const Vector3& pos);			// set position and previous position, so the jump isn't drawn
+	Vector3 getDrawPosition(int slot, float alpha);		// previous position blended alpha of the way to the current one
+	void savePositions();								// copy every position into the previous positions
+	Vector3 getDirection(int slot);
+	void setDirection(int slot, const Vector3& dir);
+};
@@ -0,0 +1,75 @@
+#include "FlowField.h"
+#include <cmath>
+
+////////////////////////////////////////////////////////////////
+// create an empty field, build() fills it in
+FlowField::FlowField()
+{
+	goal = -1;
+	revision = -1;
+}
+
+FlowField::~FlowField()
+{}
+
+////////////////////////////////////////////////////////////////
+// Dijkstra out from the goal with the same move costs and corner rules
+// as Grid::aStar. Diagonal moves are only allowed when both side nodes are
+// clear, from either end, so a neighbor of n is always a node that can
+// step to n and the outward sweep is the reverse search we need.
+void
+FlowField::build(Grid* grid, GridNode* goalNode)
+{
+	static const int diagonal_cost = sqrt(NODESIZE * NODESIZE + NODESIZE * NODESIZE);
+	int numNodes = grid->getNumRows() * grid->getNumCols();
+
+	goal = goalNode->getID();
+	revision = grid->getRevision();
+	cost.assign(numNodes, -1);
+	next.assign(numNodes, -1);
+	frontier.resize(numNodes);
+	if (!goalNode->isClear()) { return; }
+
+	cost[goal] = 0;
+	frontier.push(goal, 0);
+	while (!frontier.empty())
+	{
+		GridNode* current_node = grid->getNodeByID(frontier.pop());
+		int current = current_node->getID();
+
+		GridNode* neighbors[8];	// {North,South,East,West,NE,NW,SE,SW}, same order as getAllNeighbors
+		grid->getNeighbors(current_node, neighbors);
+		for (int i = 0; i < 8; i++)
+		{
+			if (neighbors[i] == NULL) { continue; }
+			int id = neighbors[i]->getID();
+			int new_cost = cost[current] + (i < 4 ? (int)NODESIZE : diagonal_cost);
+			if (cost[id] == -1)				// first time we reach it
+			{
+				cost[id] = new_cost;
+				next[id] = current;
+				frontier.push(id, new_cost);
+			}
+			else if (new_cost < cost[id])	// cheaper way through current, still on the frontier
+			{
+				cost[id] = new_cost;
+				next[id] = current;
+				frontier.decreaseKey(id, new_cost);
+			}
+		}
+	}
+}
+
+GridNode*
+FlowField::getNext(Grid* grid, GridNode* n)
+{
+	if (n == NULL || n->getID() >= (int)next.size()) { return NULL; }
+	return grid->getNodeByID(next[n->getID()]);
+}
+
+int
+FlowField::getCost(GridNode* n)
+{
+	if (n == NULL || n->getID() >= (int)cost.size()) { return -1; }
+	return cost[n->getID()];
+}
@@ -0,0 +1,29 @@
+////////////////////////////////////////////////////////
+// Flow field over a Grid: one Dijkstra pass out from a goal gives every
+// node its cost to the goal and the neighbor to step to next.
+// Any number of agents heading for that goal then look up their next
+// node in O(1) instead of each running its own A* search.
+
+#pragma once
+#include <vector>
+#include "Grid.h"
+
+class FlowField
+{
+private:
+	int goal;						// node ID the field leads to (-1 = not built)
+	int revision;					// grid revision the field was built on
+	std::vector<int> cost;			// cost from each node to the goal, by node ID (-1 = can't get there)
+	std::vector<int> next;			// node ID to step to from each node (-1 = at the goal or unreachable)
+	OpenList frontier;				// nodes ordered by cost while building
+
+public:
+	FlowField();
+	~FlowField();
+
+	void build(Grid* grid, GridNode* goalNode);	// sweep the grid out from goalNode
+	int getGoal() { return goal; }
+	int getRevision() { return revision; }
+	GridNode* getNext(Grid* grid, GridNode* n);	// node to walk to from n, NULL at the goal or if the goal can't be reached
+	int getCost(GridNode* n);					// cost from n to the goal, -1 if it can't be reached
+};
@@ -1,5 +1,8 @@
 #include "GameApplication.h"
 #include "Grid.h" // Lecture 5
+#include "FlockKernel.h"
+#include "AllocCounter.h"
+#include "LevelFile.h"
 #include <fstream>
 #include <sstream>
 #include <map> 
@@ -8,18 +11,12 @@
 GameApplication::GameApplication(void)
 {
 	agent = NULL; // Init member data
-	grid = NULL;
-	demoMode = false;
+	frameAllocations = 0;
 }
 //-------------------------------------------------------------------------------------
 GameApplication::~GameApplication(void)
 {
-	if (agent != NULL)  // clean up memory
-		delete agent; 
-	if (!agentList.empty())
-		agentList.clear();
-	if (grid != NULL)
-		delete grid;
+	// the agents and the grid belong to Simulation, it cleans them up
 	if (!demoGoals.empty())
 		demoGoals.clear();
 }
@@ -68,6 +65,13 @@ GameApplication::loadEnv()
 	string path = __FILE__; //gets the current cpp file's path with the cpp file
 	path = path.substr(0,1+path.find_last_of('\\')); //removes filename to leave path
 	path+= fileName;	//if txt file is in the same directory as cpp file
+
+	LevelFile level;	// a compiled level next to it is taken first (see LevelFile.h)
+	if (level.open(path.substr(0, path.find_last_of('.')) + ".lvb"))
+	{
+		loadCompiledEnv(level, fileName);
+		return;
+	}
 	inputfile.open(path);
 
 	if (!inputfile.is_open()) // oops. there was a problem opening the file
@@ -82,17 +86,7 @@ GameApplication::loadEnv()
 	string matName;
 	inputfile >> matName;	// read in the material name
 
-	// create floor mesh using the dimension read
-	MeshManager::getSingleton().createPlane("floor", ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, 
-		Plane(Vector3::UNIT_Y, 0), x*NODESIZE, z*NODESIZE, x, z, true, 1, x, z, Vector3::UNIT_Z);
-	
-	//create a floor entity, give it material, and place it at the origin
-	Entity* floor = mSceneMgr->createEntity("Floor", "floor");
-	floor->setMaterialName(matName);
-	floor->setCastShadows(false);
-	mSceneMgr->getRootSceneNode()->attachObject(floor);
-
-	this->grid = new Grid(mSceneMgr, z, x); // Set up the grid. z is rows, x is columns
+	createFloor(x, z, matName);
 	this->grid->setName(fileName);
 
 	string buf;
@@ -146,55 +140,20 @@ GameApplication::loadEnv()
 			buf = c + '\0';			// convert char to string
 			rent = objs[buf];		// find cooresponding object or agent
 			if (rent != NULL)		// it might not be an agent or object
-				if (rent->agent)	// if it is an agent...
-				{
-					// Use subclasses instead!
-					agent = new Agent(this, this->mSceneMgr, getNewName(), rent->filename, rent->y, rent->scale);
-					agentList.push_back(agent);
-					agent->setPosition(grid->getPosition(i,j).x, rent->y, grid->getPosition(i,j).z);
-					agent->setGrid(grid);						// pass pointer for grid to agent
-					agent->claimNode(grid->getNode(i,j));		// pass pointer for the gridNode agent is in
-
-					// If we were using different characters, we'd have to deal with 
-					// different animation clips. 
-				}
-				else	// Load objects
-				{
-					grid->loadObject(getNewName(), rent->filename, i, rent->y, j, rent->scale);
+			{
+				placeEntity(rent->agent ? LEVEL_AGENT : LEVEL_OBJECT, rent->filename, rent->y, rent->scale, i, j);
+				if (!rent->agent)
 					grid->getNode(i,j)->setOccupied();	// set node with an object as occupied
-				}
-			else // not an object or agent
+			}
+			else if (c == 'w') // create a wall
 			{
-				if (c == 'w') // create a wall
-				{
-					Entity* ent = mSceneMgr->createEntity(getNewName(), Ogre::SceneManager::PT_CUBE);
-					ent->setMaterialName("Examples/RustySteel");
-					Ogre::SceneNode* mNode = mSceneMgr->getRootSceneNode()->createChildSceneNode();
-					mNode->attachObject(ent);
-					mNode->scale(0.1f,0.2f,0.1f);		// cube is 100 x 100
-					grid->getNode(i,j)->setOccupied();  // indicate that agents can't pass through
-					mNode->setPosition(grid->getPosition(i,j).x, 10.0f, grid->getPosition(i,j).z);
-				}
-				else if (c == 'e')
-				{
-					ParticleSystem::setDefaultNonVisibleUpdateTimeout(5);  // set nonvisible timeout
-					ParticleSystem* ps = mSceneMgr->createParticleSystem(getNewName(), "Examples/PurpleFountain");
-					Ogre::SceneNode* mNode = mSceneMgr->getRootSceneNode()->createChildSceneNode();
-					mNode->attachObject(ps);
-					mNode->setPosition(grid->getPosition(i,j).x, 60.0f, grid->getPosition(i,j).z);
-				}
-				else if (c == 'g') //set a goal point to run to with markers
-				{
-					//set markers for goals in game
-					ParticleSystem::setDefaultNonVisibleUpdateTimeout(5);  // set nonvisible timeout
-					ParticleSystem* ps = mSceneMgr->createParticleSystem(getNewName(), "Examples/PurpleFountain");
-					Ogre::SceneNode* mNode = mSceneMgr->getRootSceneNode()->createChildSceneNode();
-					mNode->attachObject(ps);
-					mNode->setPosition(grid->getPosition(i,j).x, 0.0f, grid->getPosition(i,j).z);
-
-					demoGoals.push_back(grid->getNode(i,j));	//append node to demo walk list
-				}
+				placeEntity(LEVEL_WALL, "", 0.0f, 1.0f, i, j);
+				grid->getNode(i,j)->setOccupied();  // indicate that agents can't pass through
 			}
+			else if (c == 'e')
+				placeEntity(LEVEL_FOUNTAIN, "", 0.0f, 1.0f, i, j);
+			else if (c == 'g') //set a goal point to run to with markers
+				placeEntity(LEVEL_GOAL, "", 0.0f, 1.0f, i, j);
 		}
 	
 	// delete all of the readEntities in the objs map
@@ -209,9 +168,95 @@ GameApplication::loadEnv()
 	
 	inputfile.close();
 	grid->printToFile(); // see what the initial grid looks like.
+	grid->buildHierarchy(); // HPA* clusters (the JPS+ table is only built once JPS+ is the mode)
+	if (!demoGoals.empty()) { demoMode = true; } //toggle demo mode 
+}
+
+//////////////////////////////////////////////////////////////////
+// same from a compiled level: the walls, areas and HPA clusters go into
+// the grid in one go, then everything on the map is placed as before
+void
+GameApplication::loadCompiledEnv(const LevelFile& level, const std::string& fileName)
+{
+	createFloor(level.getNumCols(), level.getNumRows(), level.getMaterial());
+	this->grid->setName(fileName);
+	grid->loadLevel(level);
+	for (int i = 0; i < level.getNumSpawns(); i++)
+	{
+		const LevelSpawn& spawn = level.getSpawn(i);
+		const LevelType& type = level.getType(spawn.type);
+		GridNode* n = grid->getNodeByID(spawn.node);
+		placeEntity(type.kind, type.mesh == -1 ? "" : level.getString(type.mesh), type.y, type.scale, n->getRow(), n->getColumn());
+	}
+	grid->printToFile(); // see what the initial grid looks like.
 	if (!demoGoals.empty()) { demoMode = true; } //toggle demo mode 
 }
 
+void // create floor mesh using the dimension read, and the grid to go with it
+GameApplication::createFloor(int x, int z, const std::string& matName)
+{
+	using namespace Ogre;
+
+	MeshManager::getSingleton().createPlane("floor", ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, 
+		Plane(Vector3::UNIT_Y, 0), x*NODESIZE, z*NODESIZE, x, z, true, 1, x, z, Vector3::UNIT_Z);
+	
+	//create a floor entity, give it material, and place it at the origin
+	Entity* floor = mSceneMgr->createEntity("Floor", "floor");
+	floor->setMaterialName(matName);
+	floor->setCastShadows(false);
+	mSceneMgr->getRootSceneNode()->attachObject(floor);
+
+	setGrid(new Grid(mSceneMgr, z, x)); // Set up the grid. z is rows, x is columns
+}
+
+void // put what a map symbol stands for on node (r,c). Blocking the node is up to the caller
+GameApplication::placeEntity(int kind, const std::string& mesh, float y, float scale, int r, int c)
+{
+	using namespace Ogre;
+
+	if (kind == LEVEL_AGENT)	// if it is an agent...
+	{
+		// Use subclasses instead!
+		agent = new Agent(this, this->mSceneMgr, getNewName(), mesh, y, scale);
+		addAgent(agent);
+		agent->setPosition(grid->getPosition(r,c).x, y, grid->getPosition(r,c).z);
+		agent->setGrid(grid);						// pass pointer for grid to agent
+		agent->claimNode(grid->getNode(r,c));		// pass pointer for the gridNode agent is in
+
+		// If we were using different characters, we'd have to deal with 
+		// different animation clips. 
+	}
+	else if (kind == LEVEL_OBJECT)	// Load objects
+		grid->loadObject(getNewName(), mesh, r, y, c, scale);
+	else if (kind == LEVEL_WALL)
+	{
+		Entity* ent = mSceneMgr->createEntity(getNewName(), Ogre::SceneManager::PT_CUBE);
+		ent->setMaterialName("Examples/RustySteel");
+		Ogre::SceneNode* mNode = mSceneMgr->getRootSceneNode()->createChildSceneNode();
+		mNode->attachObject(ent);
+		mNode->scale(0.1f,0.2f,0.1f);		// cube is 100 x 100
+		mNode->setPosition(grid->getPosition(r,c).x, 10.0f, grid->getPosition(r,c).z);
+	}
+	else if (kind == LEVEL_FOUNTAIN)
+	{
+		ParticleSystem::setDefaultNonVisibleUpdateTimeout(5);  // set nonvisible timeout
+		ParticleSystem* ps = mSceneMgr->createParticleSystem(getNewName(), "Examples/PurpleFountain");
+		Ogre::SceneNode* mNode = mSceneMgr->getRootSceneNode()->createChildSceneNode();
+		mNode->attachObject(ps);
+		mNode->setPosition(grid->getPosition(r,c).x, 60.0f, grid->getPosition(r,c).z);
+	}
+	else if (kind == LEVEL_GOAL)	//set markers for goals in game
+	{
+		ParticleSystem::setDefaultNonVisibleUpdateTimeout(5);  // set nonvisible timeout
+		ParticleSystem* ps = mSceneMgr->createParticleSystem(getNewName(), "Examples/PurpleFountain");
+		Ogre::SceneNode* mNode = mSceneMgr->getRootSceneNode()->createChildSceneNode();
+		mNode->attachObject(ps);
+		mNode->setPosition(grid->getPosition(r,c).x, 0.0f, grid->getPosition(r,c).z);
+
+		demoGoals.push_back(grid->getNode(r,c));	//append node to demo walk list
+	}
+}
+
 void // Set up lights, shadows, etc
 GameApplication::setupEnv()
 {
@@ -296,14 +341,28 @@ GameApplication::loadCharacters()
 	// agent = new Agent(this->mSceneMgr, "Sinbad", "Sinbad.mesh");
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//frame time only feeds the simulation's clock; it steps at its own fixed
+//rate (see Simulation::advance) and the scene is drawn between steps
 void
 GameApplication::addTime(Ogre::Real deltaTime)
 {
-	// Lecture 5: Iterate over the list of agents
-	std::list<Agent*>::iterator iter;
-	for (iter = agentList.begin(); iter != agentList.end(); iter++)
-		if (*iter != NULL)
-			(*iter)->update(deltaTime);
+	unsigned long allocations = getAllocationCount();	//count heap allocations made by the update
+	int steps = advance(deltaTime);
+	frameAllocations = getAllocationCount() - allocations;
+	if (mDetailsPanel != NULL && mDetailsPanel->isVisible())
+	{
+		mDetailsPanel->setParamValue(12, Ogre::StringConverter::toString(frameAllocations));
+		mDetailsPanel->setParamValue(13, Ogre::StringConverter::toString(steps));
+		if (grid != NULL)
+		{
+			mDetailsPanel->setParamValue(14, Ogre::StringConverter::toString(grid->getPathCacheHits()));
+			mDetailsPanel->setParamValue(15, Ogre::StringConverter::toString(grid->getPathCacheMisses()));
+		}
+		mDetailsPanel->setParamValue(16, Ogre::StringConverter::toString(paths->getNumPending()));
+	}
+
+	syncNodes();	//simulation is done for this frame, show it
 }
 
 bool 
@@ -405,7 +464,7 @@ GameApplication::keyPressed( const OIS::KeyEvent &arg ) // Moved from BaseApplic
 			while (!demoGoals.empty())		//run to demo goals
 			{
 				(*agentList.begin())->toggleFlocking();
-				std::list<Agent*>::iterator iter;
+				std::vector<Agent*>::iterator iter;
 				for (iter = agentList.begin(); iter != agentList.end(); iter++)
 				{
 					(*iter)->walkTo(demoGoals.front());
@@ -420,7 +479,7 @@ GameApplication::keyPressed( const OIS::KeyEvent &arg ) // Moved from BaseApplic
 													//moved to give all agents same dest.
 			std::cout << "row: " << x << "col: " << y << std::endl;
 
-			std::list<Agent*>::iterator iter;
+			std::vector<Agent*>::iterator iter;
 			for (iter = agentList.begin(); iter != agentList.end(); iter++)
 			{			
 				if (!(*iter)->isFlocking()) { (*iter)->toggleFlocking(); }
@@ -428,18 +487,59 @@ GameApplication::keyPressed( const OIS::KeyEvent &arg ) // Moved from BaseApplic
 			}
 		}
 	}
-	else if (arg.key == OIS::KC_LCONTROL)	//run A* movement (TODO: fix it )
+	else if (arg.key == OIS::KC_J)			//cycle how moveTo searches: A*, JPS, JPS+, HPA*
 	{
-		if (!demoMode) 
+		static const char* modeNames[4] = { "A*", "JPS", "JPS+", "HPA*" };
+		SearchMode mode = (SearchMode)((grid->getSearchMode() + 1) % 4);
+		grid->setSearchMode(mode);
+		std::cout << "search mode: " << modeNames[mode] << std::endl;
+	}
+	else if (arg.key == OIS::KC_B)			//time the path searches on the current level
+	{
+		benchmarkPaths(200);
+	}
+	else if (arg.key == OIS::KC_K)			//time the flocking kernels
+	{
+		benchmarkFlockKernels(std::cout);
+	}
+	else if (arg.key == OIS::KC_V)			//everyone to one random node along a shared flow field
+	{
+		if (!demoMode)
+		{
+			GridNode* goal = grid->getNode(rand() % grid->getNumRows(), rand() % grid->getNumCols());
+			std::cout << "flow field to row: " << goal->getRow() << " col: " << goal->getColumn() << std::endl;
+			followFlow(goal);	//does nothing if the node is blocked
+		}
+	}
+	else if (arg.key == OIS::KC_P)			//everyone to one random node, each on their own D* Lite plan
+	{
+		if (!demoMode)
 		{
-			std::list<Agent*>::iterator iter;
+			GridNode* goal = grid->getNode(rand() % grid->getNumRows(), rand() % grid->getNumCols());
+			std::cout << "plan to row: " << goal->getRow() << " col: " << goal->getColumn() << std::endl;
+			std::vector<Agent*>::iterator iter;
 			for (iter = agentList.begin(); iter != agentList.end(); iter++)
+				(*iter)->planTo(goal);	//does nothing if the node is blocked
+		}
+	}
+	else if (arg.key == OIS::KC_O)			//block or clear a random node, planning agents go round it
+	{
+		GridNode* n = grid->getNode(rand() % grid->getNumRows(), rand() % grid->getNumCols());
+		setWalkable(n, !n->isClear());
+		std::cout << (n->isClear() ? "cleared" : "blocked") << " row: " << n->getRow() << " col: " << n->getColumn() << std::endl;
+	}
+	else if (arg.key == OIS::KC_LCONTROL)	//run A* movement, every agent's search on the path service
+	{
+		if (!demoMode) 
+		{
+			std::vector<GridNode*> goals;
+			for (unsigned int i = 0; i < agentList.size(); i++)
 			{		
 				int x = rand() % grid->getNumRows();	//get a random row
 				int y = rand() % grid->getNumCols();	//get a random column
-
-				(*iter)->moveTo(grid->getNode(x, y));		//run to node, avoid obstacles
+				goals.push_back(grid->getNode(x, y));
 			}
+			moveAgents(goals);		//run to the nodes, avoid obstacles
 		}
 	}
    
@@ -473,9 +573,3 @@ bool GameApplication::mouseReleased( const OIS::MouseEvent &arg, OIS::MouseButto
     mCameraMan->injectMouseUp(arg, id);
     return true;
 }
-
-std::list<Agent*> 
-GameApplication::getAgentList()
-{
-	return this->agentList;
-}
\ No newline at end of file
@@ -2,22 +2,28 @@
 #define __GameApplication_h_
 #pragma once
 #include "BaseApplication.h"
+#include "Simulation.h"
 #include "Agent.h"
 
 // forward declarations ----------------
 class Agent;
 class Grid;
 class GridNode;
+class LevelFile;
 //--------------------------------------
 
-class GameApplication : public BaseApplication
+// the simulation itself (agents, grid, flocking) lives in Simulation,
+// this adds the scene, the camera and the keyboard on top of it
+class GameApplication : public BaseApplication, public Simulation
 {
 private:
 	Agent* agent; // store a pointer to the character
-	std::list<Agent*> agentList; // Lecture 5: now a list of agents
-	Grid* grid;	// store a pointer to the grid
 	std::deque<GridNode*> demoGoals; //list of locations to walk to for flocking demo
-	bool demoMode;		//game is running demo mode
+	unsigned long frameAllocations;	//heap allocations made by the last addTime
+
+	void createFloor(int x, int z, const std::string& matName);	// floor plane and grid, x columns by z rows
+	void placeEntity(int kind, const std::string& mesh, float y, float scale, int r, int c);	// what a map symbol (LevelKind) stands for, on node (r,c)
+	void loadCompiledEnv(const LevelFile& level, const std::string& fileName);	// loadEnv from a compiled level (level_compile)
 public:
     GameApplication(void);
     virtual ~GameApplication(void);
@@ -38,8 +44,6 @@ public:
     bool mousePressed( const OIS::MouseEvent &arg, OIS::MouseButtonID id );
     bool mouseReleased( const OIS::MouseEvent &arg, OIS::MouseButtonID id );
 	////////////////////////////////////////////////////////////////////////////
-	std::list<Agent*> getAgentList();	//return the current agent list
-	bool inDemoMode() { return demoMode; }	//check if in demo mode
 
 protected:
     virtual void createScene(void);
@@ -1,31 +1,24 @@
 #include "Grid.h"
+#include "FlowField.h"
+#include "PathHierarchy.h"
+#include "SearchContext.h"
+#include "PathBatch.h"
+#include "LevelFile.h"
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <algorithm>
 
-////////////////////////////////////////////////////////////////
-// create a node
-GridNode::GridNode(int nID, int row, int column, bool isC)
-{
-	this->clear = isC;
-
-	this->rCoord = row;
-	this->cCoord = column;
-
-	this->entity = NULL;
-
-	if (isC)
-		this->contains = '.';
-	else
-		this->contains = 'B';
-}
+// {North,South,East,West,NE,NW,SE,SW}, same order as getAllNeighbors,
+// also the bit order of the move masks
+static const int dirRow[8] = { -1, 1, 0, 0, -1, -1, 1, 1 };
+static const int dirCol[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
 
-// default constructor
+////////////////////////////////////////////////////////////////
+// create a node, the grid gives it its place
 GridNode::GridNode()
 {
-	nodeID = -999;			// mark these as currently invalid
-	this->clear = true;
-	this->contains = '.';
+	this->grid = NULL;
 } 
 
 ////////////////////////////////////////////////////////////////
@@ -34,120 +27,286 @@ GridNode::~GridNode()
 {}  // doesn't contain any pointers, so it is just empty
 
 ////////////////////////////////////////////////////////////////
-// set the node id
+// set the grid the node belongs to
 void 
-GridNode::setID(int id)
+GridNode::setGrid(Grid* g)
+{
+	this->grid = g;
+}
+
+// return the position of this node
+Vector3 
+GridNode::getPosition(int rows, int cols)
 {
-	this->nodeID = id;
+	Vector3 t;
+	t.z = (getRow() * NODESIZE) - (rows * NODESIZE)/2.0 + (NODESIZE/2.0); 
+	t.y = 0; 
+	t.x = (getColumn() * NODESIZE) - (cols * NODESIZE)/2.0 + (NODESIZE/2.0); 
+	return t;
 }
 
 ////////////////////////////////////////////////////////////////
-// set the x coordinate
+// set the node as walkable
 void 
-GridNode::setRow(int r)
+GridNode::setClear()
 {
-	this->rCoord = r;
+	grid->setWalkable(getID(), true);
 }
 
 ////////////////////////////////////////////////////////////////
-// set the y coordinate
+// set the node as occupied
 void 
-GridNode::setColumn(int c)
+GridNode::setOccupied()
 {
-	this->cCoord = c;
+	grid->setWalkable(getID(), false);
 }
 
+
 ////////////////////////////////////////////////////////////////
-// get the x and y coordinate of the node
-int 
-GridNode::getRow()
+////////////////////////////////////////////////////////////////
+// open list for A*
+// Ties on F cost go to the node with the higher ID, which is the node the
+// old full-grid scan (rows then columns, <=) would have picked, so paths
+// come out exactly the same as before.
+template <class Key>
+bool
+BasicOpenList<Key>::before(const Entry& a, const Entry& b)
 {
-	return rCoord;
+	if (a.fCost != b.fCost) { return a.fCost < b.fCost; }
+	return a.nodeID > b.nodeID;
 }
 
-int 
-GridNode::getColumn()
+template <class Key>
+void
+BasicOpenList<Key>::place(int slot, const Entry& e)
 {
-	return cCoord;
+	heap[slot] = e;
+	position[e.nodeID] = slot;
 }
 
-// return the position of this node
-Ogre::Vector3 
-GridNode::getPosition(int rows, int cols)
+template <class Key>
+void
+BasicOpenList<Key>::siftUp(int slot)
 {
-	Ogre::Vector3 t;
-	t.z = (rCoord * NODESIZE) - (rows * NODESIZE)/2.0 + (NODESIZE/2.0); 
-	t.y = 0; 
-	t.x = (cCoord * NODESIZE) - (cols * NODESIZE)/2.0 + (NODESIZE/2.0); 
-	return t;
+	Entry e = heap[slot];
+	while (slot > 0)
+	{
+		int parent = (slot - 1) / 2;
+		if (!before(e, heap[parent])) { break; }
+		place(slot, heap[parent]);	// move parent down
+		slot = parent;
+	}
+	place(slot, e);
 }
 
-////////////////////////////////////////////////////////////////
-// set the node as walkable
-void 
-GridNode::setClear()
+template <class Key>
+void
+BasicOpenList<Key>::siftDown(int slot)
 {
-	this->clear = true;
-	this->contains = '.';
+	Entry e = heap[slot];
+	int size = heap.size();
+	while (true)
+	{
+		int child = 2 * slot + 1;
+		if (child >= size) { break; }
+		if (child + 1 < size && before(heap[child + 1], heap[child])) { child++; }	// pick the smaller child
+		if (!before(heap[child], e)) { break; }
+		place(slot, heap[child]);	// move child up
+		slot = child;
+	}
+	place(slot, e);
 }
 
-////////////////////////////////////////////////////////////////
-// set the node as occupied
-void 
-GridNode::setOccupied()
+template <class Key>
+void
+BasicOpenList<Key>::resize(int numNodes)
+{
+	heap.clear();
+	heap.reserve(numNodes);
+	position.assign(numNodes, -1);
+}
+
+template <class Key>
+void
+BasicOpenList<Key>::clear()
+{
+	for (unsigned int i = 0; i < heap.size(); i++)
+		position[heap[i].nodeID] = -1;
+	heap.clear();
+}
+
+template <class Key>
+void
+BasicOpenList<Key>::push(int nodeID, Key fCost)
+{
+	Entry e;
+	e.fCost = fCost;
+	e.nodeID = nodeID;
+	heap.push_back(e);
+	siftUp(heap.size() - 1);
+}
+
+template <class Key>
+void
+BasicOpenList<Key>::decreaseKey(int nodeID, Key fCost)
 {
-	this->clear = false;
-	this->contains = 'B';
+	int slot = position[nodeID];
+	assert(slot >= 0);
+	heap[slot].fCost = fCost;
+	siftUp(slot);
 }
 
+template <class Key>
+int
+BasicOpenList<Key>::pop()
+{
+	int top = heap[0].nodeID;
+	position[top] = -1;
+	Entry last = heap.back();
+	heap.pop_back();
+	if (!heap.empty())
+	{
+		heap[0] = last;
+		siftDown(0);
+	}
+	return top;
+}
+
+// the searches count in ints, GridSearch can also count in floats
+template class BasicOpenList<int>;
+template class BasicOpenList<float>;
+
 ////////////////////////////////////////////////////////////////
-// is the node walkable
-bool 
-GridNode::isClear()
+////////////////////////////////////////////////////////////////
+// path cache for A*
+// Entries remember the grid revision they were found on; a path from an
+// older revision is thrown away when it is looked up, so blocking or
+// clearing a node never hands out a stale path.
+PathCache::PathCache(unsigned int capacity)
+{
+	this->capacity = capacity;
+	hits = 0;
+	misses = 0;
+}
+
+bool
+PathCache::find(int start, int goal, int mode, int revision, std::deque<GridNode*>& path)
 {
-	return this->clear;
+	std::unordered_map<long long, EntryList::iterator>::iterator it = index.find(keyOf(start, goal));
+	if (it == index.end()) 
+	{
+		misses++;
+		return false;
+	}
+	if (it->second->revision != revision || it->second->mode != mode)	// grid changed since (or other search), drop it
+	{
+		entries.erase(it->second);
+		index.erase(it);
+		misses++;
+		return false;
+	}
+	entries.splice(entries.begin(), entries, it->second);	// now the most recently used
+	path = it->second->path;
+	hits++;
+	return true;
+}
+
+void
+PathCache::store(int start, int goal, int mode, int revision, const std::deque<GridNode*>& path)
+{
+	if (capacity == 0) { return; }
+	long long key = keyOf(start, goal);
+	std::unordered_map<long long, EntryList::iterator>::iterator it = index.find(key);
+	if (it != index.end())
+	{
+		entries.erase(it->second);
+		index.erase(it);
+	}
+	if (entries.size() >= capacity)		// full, forget the least recently used
+	{
+		index.erase(entries.back().key);
+		entries.pop_back();
+	}
+
+	Entry e;
+	e.key = key;
+	e.revision = revision;
+	e.mode = mode;
+	e.path = path;
+	entries.push_front(e);
+	index[key] = entries.begin();
 }
 
+void
+PathCache::clear()
+{
+	entries.clear();
+	index.clear();
+}
 
 ////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////
 // create a grid
+#ifdef HEADLESS
+Grid::Grid(int numRows, int numCols)
+{
+#else
 Grid::Grid(Ogre::SceneManager* mSceneMgr, int numRows, int numCols)
 {
 	this->mSceneMgr = mSceneMgr; 
+#endif
 
 	assert(numRows > 0 && numCols > 0);
 	this->nRows = numRows;
 	this->nCols = numCols;
 
-	data.resize(numCols, GridRow(numRows));
+	nodes.resize(numRows * numCols);
+	walkable.assign(numRows * numCols, 1);
+	walkBits.resize(numRows, numCols);
+	walkBits.fill();
 		
-	// put the coordinates in each node
-	int count = 0;
-	for (int i = 0; i < numRows; i++) 
-	{
-		for (int j = 0; j < numCols; j++)
-		{
-			GridNode *n = this->getNode(i,j);
-			n->setRow(i);
-			n->setColumn(j);
-			n->setID(count);
-			count++;
-		}
-	}
+	// a node's place in nodes is all it needs to know where it is
+	for (int id = 0; id < numRows * numCols; id++)
+		nodes[id].setGrid(this);
 
-	//vectors to store info for A* 
-	//initialize with zeros and resize for given level
-	fCosts.resize(this->nRows, std::vector<int>(this->nCols, 0));
-	gCosts.resize(this->nRows, std::vector<int>(this->nCols, 0));
-	hCosts.resize(this->nRows, std::vector<int>(this->nCols, 0));
-	whichList.resize(this->nRows, std::vector<int>(this->nCols, 0));
-	parents.resize(this->nRows, std::vector<GridNode*>(this->nCols, 0));
+	//every node starts clear, so every move that stays on the grid can be made
+	for (int d = 0; d < 8; d++)
+		moveOffset[d] = dirRow[d] * numCols + dirCol[d];
+	moves.resize(numRows * numCols);
+	findAllMoves();
+	componentParent.resize(numRows * numCols);
+	componentsDirty = true;	//labelled on the first question, after the level has blocked its nodes
+
+	//scratch records to store info for the searches, one per node ID,
+	//sized by the first search that needs them
+	mainContext = new SearchContext();
+	revision = 0;
+	changesBase = 0;
+	changesTrimAt = GRID_CHANGES_KEPT;
+	searchMode = SEARCH_ASTAR;
+	printSearches = true;
+#ifdef SEARCH_TRACE
+	trace = NULL;
+#endif
+	jumpTableRevision = -1;
+	hierarchy = NULL;
 }
 
 /////////////////////////////////////////
 // destroy a grid
-Grid::~Grid(){};  														
+Grid::~Grid()
+{
+	for (unsigned int i = 0; i < flowFields.size(); i++)
+		delete flowFields[i];
+	flowFields.clear();
+	if (hierarchy != NULL)
+		delete hierarchy;
+	delete mainContext;
+#ifdef SEARCH_TRACE
+	if (trace != NULL)
+		delete trace;	//writes out the searches still in its buffer
+#endif
+}  														
 
 ////////////////////////////////////////////////////////////////
 // get the node specified 
@@ -157,82 +316,77 @@ Grid::getNode(int r, int c)
 	if (r >= nRows || c >= nCols || r < 0 || c < 0)	//check if out of bounds
 		return NULL;
 
-	return &this->data[c].data[r];
+	return &this->nodes[r * nCols + c];
+}
+
+////////////////////////////////////////////////////////////////
+// get the node with the given ID (IDs are assigned row by row)
+GridNode* 
+Grid::getNodeByID(int id)
+{
+	if (id < 0 || id >= nRows * nCols)	//check if out of bounds
+		return NULL;
+
+	return &this->nodes[id];
 }
 
 ////////////////////////////////////////////////////////////////
 // get adjacent nodes;
-// utilizing the getNode method to check for neighbors
+// the move masks already know which moves can be made, diagonals
+// only if both nodes beside them are clear (no cutting corners)
+GridNode*
+Grid::neighborOf(GridNode* n, int dir)
+{
+	if (n == NULL || !(moves[n->getID()] & (1 << dir))) { return NULL; }
+	return &this->nodes[n->getID() + moveOffset[dir]];
+}
+
 GridNode* 
 Grid::getNorthNode(GridNode* n)
 {
-	if (n == NULL) { return NULL; }
-	GridNode* neighbor = getNode(n->getRow()-1, n->getColumn());
-	if (neighbor == NULL || !neighbor->isClear()) { return NULL; }
-	return neighbor;
+	return neighborOf(n, 0);
 }
 
 GridNode* 
 Grid::getSouthNode(GridNode* n)
 {
-	if (n == NULL) { return NULL; }
-	GridNode* neighbor = getNode(n->getRow()+1, n->getColumn());
-	if (neighbor == NULL || !neighbor->isClear()) { return NULL; }
-	return neighbor;
+	return neighborOf(n, 1);
 }
 
 GridNode* 
 Grid::getEastNode(GridNode* n)
 {
-	if (n == NULL) { return NULL; }
-	GridNode* neighbor = getNode(n->getRow(), n->getColumn()+1);
-	if (neighbor == NULL || !neighbor->isClear()) { return NULL; }
-	return neighbor;
+	return neighborOf(n, 2);
 }
 
 GridNode* 
 Grid::getWestNode(GridNode* n)
 {
-	if (n == NULL) { return NULL; }
-	GridNode* neighbor = getNode(n->getRow(), n->getColumn()-1);
-	if (neighbor == NULL || !neighbor->isClear()) { return NULL; }
-	return neighbor;
+	return neighborOf(n, 3);
 }
 
 GridNode* 
 Grid::getNENode(GridNode* n)  
 {
-	if (getNorthNode(n) == NULL || getEastNode(n) == NULL) { return NULL; }
-	GridNode* neighbor = getNode(getNorthNode(n)->getRow(), getEastNode(n)->getColumn());
-	if (neighbor == NULL || !neighbor->isClear()) { return NULL; }
-	return neighbor;
+	return neighborOf(n, 4);
 }
 
 GridNode* 
 Grid::getNWNode(GridNode* n) 
 {
-	if (getNorthNode(n) == NULL || getWestNode(n) == NULL) { return NULL; }
-	GridNode* neighbor = getNode(getNorthNode(n)->getRow(), getWestNode(n)->getColumn());
-	if (neighbor == NULL || !neighbor->isClear()) { return NULL; }
-	return neighbor;
+	return neighborOf(n, 5);
 }
 
 GridNode* 
 Grid::getSENode(GridNode* n) 
 {
-	if (getSouthNode(n) == NULL || getEastNode(n) == NULL) { return NULL; }
-	GridNode* neighbor = getNode(getSouthNode(n)->getRow(), getEastNode(n)->getColumn());
-	if (neighbor == NULL || !neighbor->isClear()) { return NULL; }
-	return neighbor;
+	return neighborOf(n, 6);
 }
 
 GridNode* 
 Grid::getSWNode(GridNode* n) 
 {
-	if (getSouthNode(n) == NULL || getWestNode(n) == NULL) { return NULL; }
-	GridNode* neighbor = getNode(getSouthNode(n)->getRow(), getWestNode(n)->getColumn());
-	if (neighbor == NULL || !neighbor->isClear()) { return NULL; }
-	return neighbor;
+	return neighborOf(n, 7);
 }
 
 ////////////////////////////////////////////////////////////
@@ -242,17 +396,90 @@ Grid::getSWNode(GridNode* n)
 std::vector<GridNode*>
 Grid::getAllNeighbors(GridNode* n)
 {
-	std::vector<GridNode*> neighbors;
-	neighbors.push_back(getNorthNode(n));
-	neighbors.push_back(getSouthNode(n));
-	neighbors.push_back(getEastNode(n));
-	neighbors.push_back(getWestNode(n));
-	neighbors.push_back(getNENode(n));
-	neighbors.push_back(getNWNode(n));
-	neighbors.push_back(getSENode(n));
-	neighbors.push_back(getSWNode(n));
+	std::vector<GridNode*> neighbors(8);
+	getNeighbors(n, &neighbors[0]);
 	return neighbors;
 }
+
+//same, without a vector for every expansion
+void
+Grid::getNeighbors(GridNode* n, GridNode* neighbors[8])
+{
+	for (int d = 0; d < 8; d++)
+		neighbors[d] = neighborOf(n, d);
+}
+
+////////////////////////////////////////////////////////////////
+//bit d is set if the node in direction d is on the grid and clear, and
+//for a diagonal, the two nodes beside the move are clear too
+unsigned char
+Grid::findMoves(int r, int c)
+{
+	unsigned char m = 0;
+	for (int d = 0; d < 4; d++)
+		if (isClearAt(r + dirRow[d], c + dirCol[d])) { m |= 1 << d; }
+	for (int d = 4; d < 8; d++)
+	{
+		int side1 = dirRow[d] < 0 ? 0 : 1;	// N or S
+		int side2 = dirCol[d] > 0 ? 2 : 3;	// E or W
+		if ((m & (1 << side1)) && (m & (1 << side2)) && isClearAt(r + dirRow[d], c + dirCol[d])) { m |= 1 << d; }
+	}
+	return m;
+}
+
+//findMoves for every node, from walkBits a word of nodes at a time: bit b
+//of each direction's word says whether the node that way from column
+//w * 64 + b is clear, then a diagonal needs both straight moves beside it
+static BitWord
+eastOf(const BitWord* row, int w, int rowWords)
+{
+	return (row[w] >> 1) | (w + 1 < rowWords ? row[w + 1] << 63 : 0);
+}
+
+static BitWord
+westOf(const BitWord* row, int w)
+{
+	return (row[w] << 1) | (w > 0 ? row[w - 1] >> 63 : 0);
+}
+
+void
+Grid::findAllMoves()
+{
+	int rowWords = walkBits.getRowWords();
+	for (int r = 0; r < nRows; r++)
+	{
+		const BitWord* here = walkBits.row(r);
+		const BitWord* above = r > 0 ? walkBits.row(r - 1) : NULL;
+		const BitWord* below = r + 1 < nRows ? walkBits.row(r + 1) : NULL;
+		for (int w = 0; w < rowWords; w++)
+		{
+			BitWord n = above != NULL ? above[w] : 0;
+			BitWord s = below != NULL ? below[w] : 0;
+			BitWord e = eastOf(here, w, rowWords);
+			BitWord west = westOf(here, w);
+			BitWord ne = above != NULL ? n & e & eastOf(above, w, rowWords) : 0;
+			BitWord nw = above != NULL ? n & west & westOf(above, w) : 0;
+			BitWord se = below != NULL ? s & e & eastOf(below, w, rowWords) : 0;
+			BitWord sw = below != NULL ? s & west & westOf(below, w) : 0;
+			unsigned char* m = &moves[r * nCols + w * 64];
+			int count = std::min(64, nCols - w * 64);
+			for (int b = 0; b < count; b++)
+				m[b] = (unsigned char)(((n >> b) & 1) | ((s >> b) & 1) << 1 | ((e >> b) & 1) << 2 | ((west >> b) & 1) << 3
+					| ((ne >> b) & 1) << 4 | ((nw >> b) & 1) << 5 | ((se >> b) & 1) << 6 | ((sw >> b) & 1) << 7);
+		}
+	}
+}
+
+//every move that can change when (r,c) does starts or ends next to it
+void
+Grid::updateMoves(int r, int c)
+{
+	for (int i = r - 1; i <= r + 1; i++)
+		for (int j = c - 1; j <= c + 1; j++)
+			if (i >= 0 && j >= 0 && i < nRows && j < nCols)
+				moves[i * nCols + j] = findMoves(i, j);
+}
+
 ////////////////////////////////////////////////////////////////
 //get distance between between two nodes, by the number of nodes
 //(vertically/horizontally)away times 10.
@@ -260,7 +487,7 @@ Grid::getAllNeighbors(GridNode* n)
 int 
 Grid::getDistance(GridNode* node1, GridNode* node2)
 {
-	if (node1 == NULL || node2 == NULL) { return NULL; }
+	if (node1 == NULL || node2 == NULL) { return 0; }
 	int distance;
 	distance = std::abs(node2->getRow() - node1->getRow());				//  number of row nodes away
 	distance += std::abs((node2->getColumn() - node1->getColumn()));	//+ number of col nodes away
@@ -273,6 +500,16 @@ Grid::setName(std::string name)
 	this->levelName = name;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// debug output goes in the same directory as the cpp file
+std::string
+Grid::debugFileName(std::string suffix)
+{
+	std::string path = __FILE__; //gets the current cpp file's path with the cpp file
+	path = path.substr(0,1+path.find_last_of('\\')); //removes filename to leave path
+	return path + levelName + suffix;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Print out the grid in ASCII
 void 
@@ -281,11 +518,10 @@ Grid::printToFile()
 	static int count = 0;
 	if (count == 9) { count = 0; }
 	count++;
-	std::string str_count = static_cast<std::ostringstream*>( &(std::ostringstream() << count) )->str();
-	std::string path = __FILE__; //gets the current cpp file's path with the cpp file
-	path = path.substr(0,1+path.find_last_of('\\')); //removes filename to leave path
-	path += levelName + str_count;	//include level name in agent's path file
-	path += "Grid.txt";				//if txt file is in the same directory as cpp file
+	std::ostringstream countStream;	//named, gcc won't take the address of a temporary stream
+	countStream << count;
+	std::string str_count = countStream.str();
+	std::string path = debugFileName(str_count + "Grid.txt");	//include level name in agent's path file
 	std::ofstream outFile;
 	outFile.open(path);
 
@@ -298,19 +534,13 @@ Grid::printToFile()
 	for (int i = 0; i < nRows; i++)
 	{
 		for (int j = 0; j < nCols; j++)
-		{
-			outFile << this->getNode(i, j)->contains << " ";
-			if (this->getNode(i, j)->contains != '.' 
-				&& this->getNode(i, j)->contains != 'B')
-			{
-				this->getNode(i, j)->contains = '.';
-			}
-		}
+			outFile << (walkable[i * nCols + j] ? '.' : 'B') << " ";	// B = blocked (searches are traced, see SearchTrace)
 		outFile << std::endl;
 	}
 	outFile.close();
 }
 
+#ifndef HEADLESS
 void // load and place a model in a certain location.
 Grid::loadObject(std::string name, std::string filename, int row, int height, int col, float scale)
 {
@@ -329,17 +559,25 @@ Grid::loadObject(std::string name, std::string filename, int row, int height, in
 	node->setPosition(getPosition(row, col)); 
 	node->setPosition(getPosition(row, col).x, height, getPosition(row, col).z);
 	gn->setOccupied();
-	gn->entity = ent;
+	entities[gn->getID()] = ent;
+}
+
+Ogre::Entity*
+Grid::getEntity(GridNode* n)
+{
+	std::unordered_map<int, Ogre::Entity*>::iterator found = entities.find(n->getID());
+	return found == entities.end() ? NULL : found->second;
 }
+#endif
 
 ////////////////////////////////////////////////////////////////////////////
 // Added this method and changed GridNode version to account for varying floor 
 // plane dimensions. Assumes each grid is centered at the origin.
 // It returns the center of each square. 
-Ogre::Vector3 
+Vector3 
 Grid::getPosition(int r, int c)	
 {
-	Ogre::Vector3 t;
+	Vector3 t;
 	t.z = (r * NODESIZE) - (this->nRows * NODESIZE)/2.0 + NODESIZE/2.0; 
 	t.y = 0; 
 	t.x = (c * NODESIZE) - (this->nCols * NODESIZE)/2.0 + NODESIZE/2.0; 
@@ -363,139 +601,764 @@ Grid::getNumCols()
 
 ////////////////////////////////////////////////////////////
 //calculate a path from start to end avoiding all obstacles
+//the search itself is ClassicSearch (GridSearch.h), this just traces it
+//for the debug grid: which nodes it closed and left open, and the path.
+//The trace is written out on another thread and drawn by TraceRender.
+//Only searches on the main context are traced
 std::deque<GridNode*> 
 Grid::aStar(GridNode* start, GridNode* end)
 {
-	std::deque<GridNode*> path;				//optimal path to return
+	std::deque<GridNode*> path = aStar(start, end, *mainContext);	//optimal path to return
+#ifdef SEARCH_TRACE
+	if (!printSearches) { return path; }
+	if (trace == NULL) { trace = new SearchTrace(debugFileName("Trace.bin"), nRows, nCols); }
 
-	GridNode* current_node = start;			//node we are currently checking
-	GridNode* next_node = NULL;				//node to check next
+	ClassicSearch& search = mainContext->classic;
+	for (int id = 0; id < nRows * nCols; id++)
+	{
+		if (search.isClosed(id)) { trace->addClosed(id); }
+		else if (search.isOpen(id)) { trace->addOpen(id); }
+	}
+	trace->endSearch(this, start, end, path);
+#endif
+	return path;
+}
 
-	static const int diagonal_cost = sqrt(NODESIZE * NODESIZE + NODESIZE * NODESIZE);
-	int lowest_fCost = NULL;
-	char count = '0';						//for printing path with printFile()
-	
-	static int onOpenList = -1;				//values to use for if on open/closed list
-	static int onClosedList = 0;			//	
-	onOpenList += 5;						//these values will increment with each call to aStar, so old vals are obsolete
-	onClosedList += 5;						//
-
-	whichList[current_node->getRow()][current_node->getColumn()] = onClosedList;
-	gCosts[current_node->getRow()][current_node->getColumn()] = 0;
-	current_node->contains = 'S';
-
-	while (whichList[end->getRow()][end->getColumn()] != onClosedList) //run until target node is on the closed list
-	{
-		//look at adjacent nodes and mark walkable nodes as onOpenList
-		//and assign F, G, H values
-		std::vector<GridNode*> neighbors = getAllNeighbors(current_node);
-		for (unsigned int i = 0; i < neighbors.size(); i++)
+std::deque<GridNode*> 
+Grid::aStar(GridNode* start, GridNode* end, SearchContext& context)
+{
+	return context.classic.findPath(this, start, end);
+}
+
+////////////////////////////////////////////////////////////
+//search with the grid's current mode, but a start and goal that were
+//searched before on the same walkability get the remembered path instead
+std::deque<GridNode*> 
+Grid::findPath(GridNode* start, GridNode* end)
+{
+	return findPath(start, end, searchMode);
+}
+
+std::deque<GridNode*> 
+Grid::findPath(GridNode* start, GridNode* end, SearchMode mode)
+{
+	//main thread, nobody else is searching: bring what the mode needs up to date
+	if (mode == SEARCH_JPS_PLUS && jumpTableRevision != revision) { buildJumpTable(); }
+	if (mode == SEARCH_HPA)
+	{
+		if (hierarchy == NULL) { buildHierarchy(); }
+		hierarchy->update(this);
+	}
+	return findPath(start, end, mode, *mainContext);
+}
+
+//the cache is the one thing searches share, it is only locked to look
+//a path up and to store one, never for the search
+std::deque<GridNode*> 
+Grid::findPath(GridNode* start, GridNode* end, SearchMode mode, SearchContext& context)
+{
+	std::deque<GridNode*> path;
+	{
+		std::lock_guard<std::mutex> guard(cacheLock);
+		if (pathCache.find(start->getID(), end->getID(), mode, revision, path)) { return path; }
+	}
+
+	path = search(start, end, mode, context);
+
+	std::lock_guard<std::mutex> guard(cacheLock);
+	pathCache.store(start->getID(), end->getID(), mode, revision, path);
+	return path;
+}
+
+std::deque<GridNode*> 
+Grid::search(GridNode* start, GridNode* end, SearchMode mode, SearchContext& context)
+{
+	if (mode == SEARCH_ASTAR)
+		return aStar(start, end, context);
+	else if (mode == SEARCH_HPA)
+		return hierarchicalSearch(start, end, context);
+	else
+		return jumpPointSearch(start, end, mode == SEARCH_JPS_PLUS, context);
+}
+
+////////////////////////////////////////////////////////////
+//a batch is a one off, it goes round the path cache rather than push
+//everything useful out of it. Like the other context searches nothing is
+//rebuilt here, call prepareSearches first if the grid has changed
+void
+Grid::findPaths(const std::vector<PathQuery>& queries, PathBatch& result, JobSystem* jobs)
+{
+	result.clear();
+	for (unsigned int i = 0; i < queries.size(); i++)
+		result.add(queries[i].first, queries[i].second);
+	result.solve(this, searchMode, jobs);
+}
+
+////////////////////////////////////////////////////////////
+//the walls straight into walkBits, and the move masks from those in one
+//go, rather than a setOccupied per wall. Baked components are checked as
+//far as they could do harm: blocked nodes -1, every other node a root
+//no higher than itself that is its own root. Anything not baked, or
+//baked for something else, is worked out the usual way
+void
+Grid::loadLevel(const LevelFile& level)
+{
+	assert(revision == 0 && level.getNumRows() == nRows && level.getNumCols() == nCols);	//the walls it starts with, not a change
+	walkBits.copyFrom(level.getWalkable());
+	for (int r = 0; r < nRows; r++)
+	{
+		const BitWord* row = walkBits.row(r);
+		for (int c = 0; c < nCols; c++)
+			walkable[r * nCols + c] = (row[c / 64] >> (c % 64)) & 1;
+	}
+	findAllMoves();
+
+	const int* baked = level.getComponents();
+	int numNodes = nRows * nCols;
+	int id = 0;
+	for (; baked != NULL && id < numNodes; id++)
+	{
+		int root = baked[id];
+		if (walkable[id] ? root < 0 || root > id || baked[root] != root : root != -1) { break; }
+		componentParent[id] = root;
+	}
+	componentsDirty = baked == NULL || id != numNodes;
+
+	if (level.getClusters() != NULL)
+	{
+		if (hierarchy == NULL) { hierarchy = new PathHierarchy(); }
+		if (hierarchy->load(this, level.getClusters(), level.getClustersSize())) { return; }
+		std::cout << "Baked HPA clusters don't fit this grid, building them" << std::endl;
+	}
+	buildHierarchy();
+}
+
+//the other half of loadLevel, for LevelCompile
+void
+Grid::bakeNavigation(std::vector<int>& components, std::vector<int>& clusters)
+{
+	components.resize(nRows * nCols);
+	for (int id = 0; id < nRows * nCols; id++)
+		components[id] = getComponent(&nodes[id]);
+	if (hierarchy == NULL) { buildHierarchy(); }
+	hierarchy->bake(this, clusters);
+}
+
+////////////////////////////////////////////////////////////
+//the node setters end up here, only a real change is passed on
+void
+Grid::setWalkable(int id, bool clear)
+{
+	if ((walkable[id] != 0) == clear) { return; }
+	walkable[id] = clear;
+	if (clear) { walkBits.set(id); }
+	else walkBits.clear(id);
+	walkabilityChanged(&nodes[id]);	//after, the grid redoes the move masks from it
+}
+
+////////////////////////////////////////////////////////////
+//a node was cleared or blocked: the moves around it change, every cached
+//path is stale, the clusters around it need their entrances found again,
+//and areas are joined (cleared) or may have split (blocked, relabelled later)
+void
+Grid::walkabilityChanged(GridNode* n)
+{
+	updateMoves(n->getRow(), n->getColumn());
+	if (!n->isClear())	//may have cut an area in two, find out when someone asks
+		componentsDirty = true;
+	else if (!componentsDirty)	//joins the areas around it, and every move it opened up has it beside both ends
+	{
+		int id = n->getID();
+		componentParent[id] = id;
+		for (int d = 0; d < 8; d++)
+			if (moves[id] & (1 << d)) { joinComponents(id, id + moveOffset[d]); }
+	}
+	revision++;
+	changes.push_back(n->getID());	//incremental planners (DStarLite) catch up from here
+	if ((int)changes.size() >= changesTrimAt)
+		trimChanges();
+	if (hierarchy != NULL)
+		hierarchy->markDirty(this, n);
+}
+
+////////////////////////////////////////////////////////////
+//a planner takes in the changes when its agent asks for the next step,
+//so the log only keeps what the furthest behind of them hasn't seen.
+//The readers are only looked over once the log has doubled since last
+//time, not on every change
+void
+Grid::trimChanges()
+{
+	int oldest = revision;
+	for (unsigned int i = 0; i < changeReaders.size(); i++)
+		if (changeReaders[i] != -1)
+			oldest = std::min(oldest, changeReaders[i]);
+	changes.erase(changes.begin(), changes.begin() + (oldest - changesBase));
+	changesBase = oldest;
+	changesTrimAt = std::max((int)changes.size() * 2, GRID_CHANGES_KEPT);
+}
+
+int
+Grid::followChanges()
+{
+	int reader;
+	if (!freeReaders.empty())
+	{
+		reader = freeReaders.back();
+		freeReaders.pop_back();
+	}
+	else
+	{
+		reader = changeReaders.size();
+		changeReaders.push_back(-1);
+	}
+	changeReaders[reader] = revision;
+	return reader;
+}
+
+void
+Grid::unfollowChanges(int reader)
+{
+	changeReaders[reader] = -1;
+	freeReaders.push_back(reader);
+}
+
+void
+Grid::buildHierarchy()
+{
+	if (hierarchy == NULL)
+		hierarchy = new PathHierarchy();
+	hierarchy->build(this);
+}
+
+////////////////////////////////////////////////////////////
+//the searches never fix these up themselves, that would be writing to the
+//grid while others read it. Only what was built before is kept up, and
+//the JPS+ table while that is the mode (a compiled level doesn't bake it)
+void
+Grid::prepareSearches()
+{
+	if ((jumpTableRevision != -1 || searchMode == SEARCH_JPS_PLUS) && jumpTableRevision != revision)
+		buildJumpTable();
+	if (hierarchy != NULL)
+		hierarchy->update(this);
+	if (componentsDirty)
+		labelComponents();
+}
+
+bool
+Grid::needsPreparing()
+{
+	return ((jumpTableRevision != -1 || searchMode == SEARCH_JPS_PLUS) && jumpTableRevision != revision)
+		|| (hierarchy != NULL && hierarchy->isDirty()) || componentsDirty;
+}
+
+////////////////////////////////////////////////////////////
+//HPA*: search over the cluster entrances, then fill in only the clusters
+//the path goes through. Clusters the grid was changed in are linked again first.
+std::deque<GridNode*> 
+Grid::hierarchicalSearch(GridNode* start, GridNode* end)
+{
+	if (hierarchy == NULL) { buildHierarchy(); }
+	hierarchy->update(this);	//main thread, nobody else is searching
+	return hierarchicalSearch(start, end, *mainContext);
+}
+
+//the links of changed clusters can't be trusted and this can't redo them
+//(others may be reading them), so until prepareSearches does it is plain A*
+std::deque<GridNode*> 
+Grid::hierarchicalSearch(GridNode* start, GridNode* end, SearchContext& context)
+{
+	if (hierarchy == NULL || hierarchy->isDirty()) { return aStar(start, end, context); }
+	return hierarchy->findPath(this, start, end, context);
+}
+
+////////////////////////////////////////////////////////////
+//return a flow field leading to goal. Fields for the last few goals are
+//kept, and one is only swept again when the walkability has changed since.
+//Every agent heading for goal shares it, so the search is paid once, not per agent
+FlowField*
+Grid::flowTo(GridNode* goal)
+{
+	FlowField* field = NULL;
+	for (unsigned int i = 0; i < flowFields.size(); i++)
+	{
+		if (flowFields[i]->getGoal() == goal->getID())
+		{
+			field = flowFields[i];
+			flowFields.erase(flowFields.begin() + i);
+			break;
+		}
+	}
+	if (field == NULL)
+	{
+		if (flowFields.size() >= FLOW_FIELD_LIMIT)	// forget the goal asked for longest ago
+		{
+			field = flowFields.back();
+			flowFields.pop_back();
+		}
+		else
+			field = new FlowField();
+		field->build(this, goal);
+	}
+	else if (field->getRevision() != revision)
+		field->build(this, goal);
+	flowFields.insert(flowFields.begin(), field);
+	return field;
+}
+
+////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////
+// jump point search
+// The levels are uniform cost and diagonal moves need both side nodes
+// clear (see getNENode), so a straight or diagonal run only has to stop
+// where a wall opens up a way the run itself couldn't have taken more
+// cheaply. Only those jump points go on the open list.
+// Directions are in getAllNeighbors order: N, S, E, W, NE, NW, SE, SW.
+
+static int
+directionOf(int dr, int dc)
+{
+	for (int d = 0; d < 8; d++)
+		if (dirRow[d] == dr && dirCol[d] == dc) { return d; }
+	return -1;
+}
+
+static int
+sign(int v)
+{
+	return (v > 0) - (v < 0);
+}
+
+bool
+Grid::isClearAt(int r, int c)
+{
+	if (r >= nRows || c >= nCols || r < 0 || c < 0) { return false; }
+	return this->walkable[r * nCols + c] != 0;
+}
+
+////////////////////////////////////////////////////////////////
+// walk from (r,c) in a straight line until a node with a forced neighbor
+// (a side node that is open here but was blocked one step back), the goal,
+// or a wall. Returns the node ID of the jump point, -1 for the wall
+int
+Grid::jumpStraight(int r, int c, int dr, int dc, int goal)
+{
+	while (isClearAt(r, c))
+	{
+		int id = r * nCols + c;
+		if (id == goal) { return id; }
+		if (dc != 0)	// east/west, look north and south
+		{
+			if ((isClearAt(r - 1, c) && !isClearAt(r - 1, c - dc)) 
+				|| (isClearAt(r + 1, c) && !isClearAt(r + 1, c - dc))) { return id; }
+		}
+		else			// north/south, look east and west
+		{
+			if ((isClearAt(r, c - 1) && !isClearAt(r - dr, c - 1)) 
+				|| (isClearAt(r, c + 1) && !isClearAt(r - dr, c + 1))) { return id; }
+		}
+		r += dr;
+		c += dc;
+	}
+	return -1;
+}
+
+////////////////////////////////////////////////////////////////
+// walk from (r,c) diagonally. A node is a jump point if either of the
+// straight runs along the diagonal's sides finds one
+int
+Grid::jumpDiagonal(int r, int c, int dr, int dc, int goal)
+{
+	while (isClearAt(r, c))
+	{
+		int id = r * nCols + c;
+		if (id == goal) { return id; }
+		if (jumpStraight(r, c + dc, 0, dc, goal) != -1 
+			|| jumpStraight(r + dr, c, dr, 0, goal) != -1) { return id; }
+		if (!isClearAt(r, c + dc) || !isClearAt(r + dr, c)) { return -1; }	// no cutting corners
+		r += dr;
+		c += dc;
+	}
+	return -1;
+}
+
+////////////////////////////////////////////////////////////////
+// the directions a search has to look in from (r,c), arriving from
+// parent (-1 for the start, which looks everywhere). Returns how many
+// were written to dirs.
+int
+Grid::jumpDirections(int r, int c, int parent, int dirs[8])
+{
+	int count = 0;
+	if (parent < 0)
+	{
+		for (int d = 0; d < 4; d++)
+			if (isClearAt(r + dirRow[d], c + dirCol[d])) { dirs[count++] = d; }
+		for (int d = 4; d < 8; d++)
+			if (isClearAt(r + dirRow[d], c) && isClearAt(r, c + dirCol[d]) 
+				&& isClearAt(r + dirRow[d], c + dirCol[d])) { dirs[count++] = d; }
+		return count;
+	}
+
+	int dr = sign(r - parent / nCols);
+	int dc = sign(c - parent % nCols);
+	if (dr != 0 && dc != 0)		// diagonal: keep going, or peel off along either side
+	{
+		bool rowOpen = isClearAt(r + dr, c);
+		bool colOpen = isClearAt(r, c + dc);
+		if (rowOpen) { dirs[count++] = directionOf(dr, 0); }
+		if (colOpen) { dirs[count++] = directionOf(0, dc); }
+		if (rowOpen && colOpen) { dirs[count++] = directionOf(dr, dc); }
+	}
+	else if (dc != 0)			// east/west: ahead, the diagonals ahead, and both sides
+	{
+		bool ahead = isClearAt(r, c + dc);
+		bool north = isClearAt(r - 1, c);
+		bool south = isClearAt(r + 1, c);
+		if (ahead)
 		{
-			// if neighbor is a valid adjacent node, assign costs and mark onOpenList
-			if (neighbors[i] != NULL 
-				&& whichList[neighbors[i]->getRow()][neighbors[i]->getColumn()] != onClosedList) 
+			dirs[count++] = directionOf(0, dc);
+			if (north) { dirs[count++] = directionOf(-1, dc); }
+			if (south) { dirs[count++] = directionOf(1, dc); }
+		}
+		if (north) { dirs[count++] = directionOf(-1, 0); }
+		if (south) { dirs[count++] = directionOf(1, 0); }
+	}
+	else						// north/south
+	{
+		bool ahead = isClearAt(r + dr, c);
+		bool east = isClearAt(r, c + 1);
+		bool west = isClearAt(r, c - 1);
+		if (ahead)
+		{
+			dirs[count++] = directionOf(dr, 0);
+			if (east) { dirs[count++] = directionOf(dr, 1); }
+			if (west) { dirs[count++] = directionOf(dr, -1); }
+		}
+		if (east) { dirs[count++] = directionOf(0, 1); }
+		if (west) { dirs[count++] = directionOf(0, -1); }
+	}
+	return count;
+}
+
+////////////////////////////////////////////////////////////////
+// JPS+: the jump from (r,c) in direction dir, read from the table.
+// the table doesn't know the goal, so a goal on the line ahead (or
+// level with a node on the diagonal ahead) is checked for here
+int
+Grid::jumpPlus(int r, int c, int dir, int goal)
+{
+	int dist = jumpTable[(r * nCols + c) * 8 + dir];
+	int reach = dist > 0 ? dist : -dist;	// steps that can be taken before the wall or on the jump point
+	int dr = dirRow[dir], dc = dirCol[dir];
+	int gr = goal / nCols, gc = goal % nCols;
+
+	if (dr == 0 || dc == 0)		// straight
+	{
+		bool inLine = dr == 0 ? (gr == r && sign(gc - c) == dc) : (gc == c && sign(gr - r) == dr);
+		int steps = dr == 0 ? std::abs(gc - c) : std::abs(gr - r);
+		if (inLine && steps <= reach) { return goal; }
+	}
+	else if (sign(gr - r) == dr && sign(gc - c) == dc)	// goal somewhere ahead of the diagonal
+	{
+		int steps = std::min(std::abs(gr - r), std::abs(gc - c));
+		if (steps <= reach) { return (r + dr * steps) * nCols + (c + dc * steps); }	// level with the goal, go straight from there
+	}
+	if (dist <= 0) { return -1; }
+	return (r + dr * dist) * nCols + (c + dc * dist);
+}
+
+////////////////////////////////////////////////////////////////
+// precompute JPS+ jump distances. For every node and direction: the steps
+// to the next jump point that way (> 0), or the steps that can be taken
+// before running into a wall (<= 0). Straight runs first, the diagonals
+// are built from them. Each entry only needs the one a step further on,
+// so every direction is filled in one sweep that starts at its far edge.
+void
+Grid::buildJumpTable()
+{
+	jumpTable.assign(nRows * nCols * 8, 0);
+	for (int d = 0; d < 8; d++)
+	{
+		int dr = dirRow[d], dc = dirCol[d];
+		for (int i = 0; i < nRows; i++)
+		{
+			int r = dr > 0 ? nRows - 1 - i : i;	// far edge first
+			for (int j = 0; j < nCols; j++)
 			{
-				//if not already marked onOpen
-				if (whichList[neighbors[i]->getRow()][neighbors[i]->getColumn()] != onOpenList)
+				int c = dc > 0 ? nCols - 1 - j : j;
+				int nr = r + dr, nc = c + dc;	// the next node that way
+				int& dist = jumpTable[(r * nCols + c) * 8 + d];
+				if (!isClearAt(nr, nc)) { dist = 0; continue; }
+
+				bool jumpPoint;
+				if (dr == 0)			// east/west: a forced neighbor north or south of the next node
+					jumpPoint = (isClearAt(nr - 1, nc) && !isClearAt(nr - 1, c)) 
+						|| (isClearAt(nr + 1, nc) && !isClearAt(nr + 1, c));
+				else if (dc == 0)		// north/south
+					jumpPoint = (isClearAt(nr, nc - 1) && !isClearAt(r, nc - 1)) 
+						|| (isClearAt(nr, nc + 1) && !isClearAt(r, nc + 1));
+				else					// diagonal: no corner cutting, then a straight jump point along either side
 				{
-					whichList[neighbors[i]->getRow()][neighbors[i]->getColumn()] = onOpenList;
-					//assign Costs -------------------------------------------------------------------------------
-					if (neighbors[i]->getRow() != current_node->getRow() 
-						&& neighbors[i]->getColumn() != current_node->getColumn())
-					{  //diagonal move (NE,NW,SE,SW)
-						gCosts[neighbors[i]->getRow()][neighbors[i]->getColumn()] = 
-							diagonal_cost + gCosts[current_node->getRow()][current_node->getColumn()];
-					}
-					else
-					{  //horizontal/vertical move (N,S,E,W)
-						gCosts[neighbors[i]->getRow()][neighbors[i]->getColumn()] = 
-							NODESIZE + gCosts[current_node->getRow()][current_node->getColumn()];
-					}
-					parents[neighbors[i]->getRow()][neighbors[i]->getColumn()] = current_node;
-					hCosts[neighbors[i]->getRow()][neighbors[i]->getColumn()] = getDistance(neighbors[i], end);
-					fCosts[neighbors[i]->getRow()][neighbors[i]->getColumn()] =
-													  gCosts[neighbors[i]->getRow()][neighbors[i]->getColumn()]
-													+ hCosts[neighbors[i]->getRow()][neighbors[i]->getColumn()];
-					//Costs assigned ------------------------------------------------------------------------------
-					neighbors[i]->contains = '-'; //displays open list nodes in print to file
+					if (!isClearAt(r, nc) || !isClearAt(nr, c)) { dist = 0; continue; }
+					int next = (nr * nCols + nc) * 8;
+					jumpPoint = jumpTable[next + directionOf(0, dc)] > 0 || jumpTable[next + directionOf(dr, 0)] > 0;
 				}
-				else //node is already marked onOpenList
-				{
-					//calculate possible new gCost ----------------------------------------------------------------
-					int new_gCost;	
-					if (neighbors[i]->getRow() != current_node->getRow() 
-						&& neighbors[i]->getColumn() != current_node->getColumn())
-					{  //diagonal move (NE,NW,SE,SW)
-						new_gCost = diagonal_cost + gCosts[current_node->getRow()][current_node->getColumn()];
-					}
-					else
-					{  //horizontal/vertical move (N,S,E,W)
-						new_gCost = NODESIZE + gCosts[current_node->getRow()][current_node->getColumn()];
-					}
 
-					//if new cost is lower, change the parent and recalculate F ////////
-					if (new_gCost < gCosts[neighbors[i]->getRow()][neighbors[i]->getColumn()])
-					{
-						gCosts[neighbors[i]->getRow()][neighbors[i]->getColumn()] = new_gCost;
-						parents[neighbors[i]->getRow()][neighbors[i]->getColumn()] = current_node;
-						hCosts[neighbors[i]->getRow()][neighbors[i]->getColumn()] = getDistance(neighbors[i], end);
-						fCosts[neighbors[i]->getRow()][neighbors[i]->getColumn()] =
-													  gCosts[neighbors[i]->getRow()][neighbors[i]->getColumn()]
-													+ hCosts[neighbors[i]->getRow()][neighbors[i]->getColumn()];
-					}
-					//else do nothing
-					//Costs re-assigned ----------------------------------------------------------------------------
-				}
+				int further = jumpTable[(nr * nCols + nc) * 8 + d];
+				if (jumpPoint) { dist = 1; }
+				else if (further > 0) { dist = further + 1; }
+				else { dist = further - 1; }
 			}
-		}//end for
+		}
+	}
+	jumpTableRevision = revision;
+}
+
+////////////////////////////////////////////////////////////////
+// A* over jump points only, with the octile distance as the heuristic,
+// which never overestimates here, so the path is always a shortest one.
+// usePlus reads the jumps from the JPS+ table instead of walking them out.
+// The path comes back like aStar's: every node, start left off, end included.
+std::deque<GridNode*> 
+Grid::jumpPointSearch(GridNode* start, GridNode* end, bool usePlus)
+{
+	if (usePlus && jumpTableRevision != revision) { buildJumpTable(); }	//main thread, nobody else is searching
+	return jumpPointSearch(start, end, usePlus, *mainContext);
+}
+
+//a table from before the last change would jump through walls, and this
+//can't rebuild it (others may be reading it), so until prepareSearches
+//does the jumps are walked out instead
+std::deque<GridNode*> 
+Grid::jumpPointSearch(GridNode* start, GridNode* end, bool usePlus, SearchContext& context)
+{
+	static const int diagonal_cost = sqrt(NODESIZE * NODESIZE + NODESIZE * NODESIZE);
+	std::deque<GridNode*> path;
+	if (start == NULL || end == NULL || !end->isClear()) { return path; }
+	if (jumpTableRevision != revision) { usePlus = false; }
+
+	int goal = end->getID();
+	int gr = end->getRow(), gc = end->getColumn();
+	context.fit(nRows * nCols);
+	std::vector<SearchNode>& searchData = context.searchData;
+	OpenList& openList = context.openList;
+	int onOpenList, onClosedList;
+	context.newSearch(onOpenList, onClosedList);
+
+	SearchNode& first = searchData[start->getID()];
+	first.whichList = onOpenList;
+	first.gCost = 0;
+	first.parent = -1;
+	openList.push(start->getID(), 0);
+
+	bool found = false;
+	while (!openList.empty())
+	{
+		int current = openList.pop();
+		SearchNode& node = searchData[current];
+		node.whichList = onClosedList;
+		if (current == goal) { found = true; break; }
 
-		//at this point, nodes on the open list will have re-assigned F values
-		//Pick the node with the lowest F value ------------------------------------------------
-		for (int i = 0; i < getNumRows(); i++)
+		int r = current / nCols, c = current % nCols;
+		int dirs[8];
+		int numDirs = jumpDirections(r, c, current == start->getID() ? -1 : node.parent, dirs);
+		for (int i = 0; i < numDirs; i++)
 		{
-			for (int j = 0; j < getNumCols(); j++)
+			int d = dirs[i];
+			int jump;
+			if (usePlus)
+				jump = jumpPlus(r, c, d, goal);
+			else if (d < 4)
+				jump = jumpStraight(r + dirRow[d], c + dirCol[d], dirRow[d], dirCol[d], goal);
+			else
+				jump = jumpDiagonal(r + dirRow[d], c + dirCol[d], dirRow[d], dirCol[d], goal);
+			if (jump == -1) { continue; }
+
+			SearchNode& next = searchData[jump];
+			if (next.whichList == onClosedList) { continue; }
+
+			int jr = jump / nCols, jc = jump % nCols;
+			int steps = std::max(std::abs(jr - r), std::abs(jc - c));
+			int new_gCost = node.gCost + steps * (d < 4 ? (int)NODESIZE : diagonal_cost);
+			int dR = std::abs(gr - jr), dC = std::abs(gc - jc);
+			int h = (int)NODESIZE * std::max(dR, dC) + (diagonal_cost - (int)NODESIZE) * std::min(dR, dC);	// octile distance
+
+			if (next.whichList != onOpenList)
 			{
-				if (whichList[i][j] == onOpenList)	//check only nodes marked onOpenList
+				next.whichList = onOpenList;
+				next.gCost = new_gCost;
+				next.parent = current;
+				next.fCost = new_gCost + h;
+				openList.push(jump, next.fCost);
+			}
+			else if (new_gCost < next.gCost)
+			{
+				next.gCost = new_gCost;
+				next.parent = current;
+				next.fCost = new_gCost + h;
+				openList.decreaseKey(jump, next.fCost);
+			}
+		}
+	}
+	if (!found) { return path; }
+
+	//fill in the nodes between each jump point and its parent
+	int current = goal;
+	while (current != start->getID())
+	{
+		int parent = searchData[current].parent;
+		int dr = sign(current / nCols - parent / nCols);
+		int dc = sign(current % nCols - parent % nCols);
+		for (int id = current; id != parent; id -= dr * nCols + dc)
+			path.push_front(getNodeByID(id));
+		current = parent;
+	}
+	return path;
+}
+
+////////////////////////////////////////////////////////////////
+// total cost of walking path from start, with the same move costs as the searches
+int
+Grid::getPathCost(GridNode* start, const std::deque<GridNode*>& path)
+{
+	static const int diagonal_cost = sqrt(NODESIZE * NODESIZE + NODESIZE * NODESIZE);
+	int cost = 0;
+	GridNode* previous = start;
+	for (unsigned int i = 0; i < path.size(); i++)
+	{
+		bool diagonal = path[i]->getRow() != previous->getRow() && path[i]->getColumn() != previous->getColumn();
+		cost += diagonal ? diagonal_cost : (int)NODESIZE;
+		previous = path[i];
+	}
+	return cost;
+}
+
+////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////
+// connected components
+// Moves are the same both ways (see findMoves), so the clear nodes fall
+// into areas where every node can reach every other and none outside.
+// Clearing a node only joins areas, which the union-find takes in as it
+// happens; blocking one can split an area, which only a new flood fill
+// can tell, so that waits until the next question.
+// The floods go a row of words at a time (Bitboard::flood). Each starts
+// from the lowest clear node not in an area yet, which is the area's root.
+void
+Grid::labelComponents()
+{
+	int numNodes = nRows * nCols;
+	if (areaBits.getNumRows() != nRows)
+	{
+		areaBits.resize(nRows, nCols);
+		unlabeledBits.resize(nRows, nCols);
+	}
+	for (int id = 0; id < numNodes; id++)
+		componentParent[id] = -1;	// blocked, unless a flood gets there
+	unlabeledBits = walkBits;
+
+	int rowWords = walkBits.getRowWords();
+	for (int r = 0; r < nRows; r++)
+		for (int w = 0; w < rowWords; w++)
+			while (unlabeledBits.row(r)[w] != 0)
+			{
+				int root = r * nCols + w * 64 + lowestBit(unlabeledBits.row(r)[w]);
+				int firstRow, lastRow, firstWord, lastWord;
+				areaBits.flood(root, walkBits, floodStack, firstRow, lastRow, firstWord, lastWord);
+				for (int ar = firstRow; ar <= lastRow; ar++)	// label the area, and leave areaBits clear again
 				{
-					if (lowest_fCost == NULL || fCosts[i][j] <= lowest_fCost)
+					BitWord* area = areaBits.row(ar);
+					BitWord* left = unlabeledBits.row(ar);
+					for (int aw = firstWord; aw <= lastWord; aw++)
 					{
-						lowest_fCost = fCosts[i][j];
-						next_node = getNode(i,j);
+						BitWord b = area[aw];
+						if (b == 0) { continue; }
+						area[aw] = 0;
+						left[aw] &= ~b;
+						for (; b != 0; b &= b - 1)
+							componentParent[ar * nCols + aw * 64 + lowestBit(b)] = root;
 					}
 				}
 			}
-		}
-		if (lowest_fCost == NULL) // No path available
-		{
-			//std::cout << "No path!!" << std::endl;
-			start->contains = 'X';	//X for no path found
-			end->contains = 'E';
-			printToFile();
-			return path; //return empty path
-		} 
-		//node is picked, assign to current node and mark onClosedList
-		lowest_fCost = NULL;
-		current_node = next_node;
-		whichList[current_node->getRow()][current_node->getColumn()] = onClosedList;
-		current_node->contains = '~';	//displays closed list nodes in the print to file
-		// --------------------------------------------------------------------------------------
-
-	}//end while
-
-	//set up deque for path to return
-	while (current_node != start)
-	{
-		path.push_front(current_node);
-		current_node = parents[current_node->getRow()][current_node->getColumn()];
-	}
-	//and assign path numbers
-	for (unsigned int i = 0; i < path.size(); i++)
+	componentsDirty = false;
+}
+
+int
+Grid::findComponent(int id)
+{
+	if (componentParent[id] == -1) { return -1; }
+	while (componentParent[id] != id)
 	{
-		path[i]->contains = count;
-		if (count == '9') { count = '0'; }
-		else count++;
+		componentParent[id] = componentParent[componentParent[id]];	// path halving
+		id = componentParent[id];
 	}
-	end->contains = 'E';
-	printToFile(); //move this to while their running instead of before
-	return path;
-}
\ No newline at end of file
+	return id;
+}
+
+void
+Grid::joinComponents(int a, int b)
+{
+	a = findComponent(a);
+	b = findComponent(b);
+	if (a == -1 || b == -1 || a == b) { return; }
+	if (a < b) { componentParent[b] = a; }	// lower ID as the root, any rule will do
+	else { componentParent[a] = b; }
+}
+
+int
+Grid::getComponent(GridNode* n)
+{
+	if (n == NULL) { return -1; }
+	if (componentsDirty) { labelComponents(); }
+	return findComponent(n->getID());
+}
+
+////////////////////////////////////////////////////////////////
+//an agent can stand on a node that has been blocked since, the searches
+//still step off it, so then any area it can step into counts
+bool
+Grid::isReachable(GridNode* from, GridNode* to)
+{
+	if (from == NULL || to == NULL) { return false; }
+	if (from == to) { return true; }
+	int goal = getComponent(to);
+	if (goal == -1) { return false; }
+	if (from->isClear()) { return getComponent(from) == goal; }
+	for (int d = 0; d < 8; d++)
+		if ((moves[from->getID()] & (1 << d)) && findComponent(from->getID() + moveOffset[d]) == goal) { return true; }
+	return false;
+}
+
+////////////////////////////////////////////////////////////////
+//look round goal in growing squares for the nearest node (straight line)
+//from can reach. A node k squares out is at least k away, so once the
+//best so far is closer than that nothing further out can beat it
+GridNode*
+Grid::nearestReachable(GridNode* from, GridNode* goal)
+{
+	if (from == NULL || goal == NULL) { return NULL; }
+	if (isReachable(from, goal)) { return goal; }
+
+	GridNode* best = NULL;
+	int bestDistance = 0;	// squared, in nodes
+	int maxRing = std::max(nRows, nCols);
+	for (int k = 1; k <= maxRing && (best == NULL || k * k < bestDistance); k++)
+		for (int r = goal->getRow() - k; r <= goal->getRow() + k; r++)
+		{
+			int step = (r == goal->getRow() - k || r == goal->getRow() + k) ? 1 : 2 * k;	// whole top and bottom rows, just the ends of the others
+			for (int c = goal->getColumn() - k; c <= goal->getColumn() + k; c += step)
+			{
+				GridNode* n = getNode(r, c);
+				if (n == NULL || !isReachable(from, n)) { continue; }
+				int dR = r - goal->getRow();
+				int dC = c - goal->getColumn();
+				if (best == NULL || dR * dR + dC * dC < bestDistance)
+				{
+					best = n;
+					bestDistance = dR * dR + dC * dC;
+				}
+			}
+		}
+	return best;
+}
@@ -10,62 +10,188 @@
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <deque>
+#include <list>
+#include <utility>
+#include <unordered_map>
+#include <mutex>
 #include <assert.h>
-#include "GameApplication.h"
+#include "SimMath.h"
+#include "SearchTrace.h"
+#include "Bitboard.h"
+#ifndef HEADLESS
+#include "BaseApplication.h"
+#endif
 
 #define NODESIZE 10.0
+#define PATH_CACHE_SIZE 256	// A* results kept by the path cache
+#define FLOW_FIELD_LIMIT 4		// flow fields a grid keeps, one per goal
+#define GRID_CHANGES_KEPT 1024	// walkability changes logged before the log is first trimmed to what its readers still need
 
+enum SearchMode {		// how Grid::findPath searches
+	SEARCH_ASTAR,		// aStar, every neighbor of every node expanded
+	SEARCH_JPS,			// jump point search, straight runs skipped over
+	SEARCH_JPS_PLUS,	// jump point search with the jump distances looked up in a table
+	SEARCH_HPA			// hierarchical, over cluster entrances (see PathHierarchy)
+};
+
+class Grid;
+class FlowField;
+class PathHierarchy;
+class GridNode;
+class SearchContext;
+class PathBatch;
+class JobSystem;
+class LevelFile;
+class SearchTrace;
+
+typedef std::pair<GridNode*, GridNode*> PathQuery;	// start and goal
+
+// A node is only a handle: its ID is its place in the grid's node array,
+// the row and column follow from the ID, and whether it is walkable is
+// kept in the grid's walkability array, which is what the searches read.
 class GridNode {
 private:
-	int nodeID;			// identify for the node
-	int rCoord;			// row coordinate
-	int cCoord;			// column coordinate
-	bool clear;			// is the node walkable?
+	Grid* grid;			// grid the node belongs to, told when walkability changes
 			
 public:
-	Ogre::Entity *entity;	// a pointer to the entity in this node
-	char contains;		// For printing... B = blocked, S = start, G = goal, numbers = path
 	GridNode();			// default constructor
-	GridNode(int nID, int row, int column, bool isC = true);	// create a node
 	~GridNode();		// destroy a node
 
-	void setID(int id);				// set the node id
-	int getID(){return nodeID;};	// get the node ID
-	void setRow(int r);				// set the row coordinate
-	void setColumn(int c);			// set the column coordinate
+	void setGrid(Grid* g);			// set the grid the node belongs to
+	int getID();					// get the node ID
 	int getRow();					// get the row and column coordinate of the node
 	int getColumn();
-	Ogre::Vector3 getPosition(int rows, int cols);	// return the position of this node
+	Vector3 getPosition(int rows, int cols);	// return the position of this node
 	void setClear();		// set the node as walkable
 	void setOccupied();		// set the node as occupied
 	bool isClear();			// is the node walkable
 };
 
-class GridRow {  // helper class
+class SearchNode {  // helper class: A* bookkeeping for one node, kept together so an expansion touches one record
 public:
-	std::vector<GridNode> data;
-	GridRow(int size) {data.resize(size);};
-	~GridRow(){};
+	int fCost;			// f = g + h
+	int gCost;			// cost to move to node so far
+	int whichList;		// on open/closed list?
+	int parent;			// node ID of the parent node (-1 = none)
+	SearchNode() : fCost(0), gCost(0), whichList(0), parent(-1) {};
+};
+
+template <class Key>
+class BasicOpenList {  // helper class: indexed binary min-heap of open node IDs, keyed on F cost (int or float, see Grid.cpp)
+private:
+	struct Entry {
+		Key fCost;			// F cost the node was pushed or decreased with
+		int nodeID;			// the open node
+	};
+	std::vector<Entry> heap;		// the heap itself, lowest F at heap[0]
+	std::vector<int> position;		// heap slot of each node, by node ID (-1 = not in heap)
+
+	bool before(const Entry& a, const Entry& b);	// heap ordering
+	void siftUp(int slot);
+	void siftDown(int slot);
+	void place(int slot, const Entry& e);			// put an entry in a slot and record its position
+public:
+	void resize(int numNodes);		// size the position table for a grid with numNodes nodes
+	void clear();					// empty the heap, only touching nodes that are still in it
+	bool empty() { return heap.empty(); }
+	void push(int nodeID, Key fCost);			// add a node to the open list
+	void decreaseKey(int nodeID, Key fCost);	// node already on the list got a lower F cost
+	int pop();									// remove and return the node with the lowest F cost
+};
+typedef BasicOpenList<int> OpenList;	// the grid's searches all count in ints
+
+class PathCache {  // helper class: least recently used A* results, keyed on start and goal node IDs
+private:
+	struct Entry {
+		long long key;					// start and goal node IDs
+		int revision;					// grid revision the path was found on
+		int mode;						// SearchMode it was found with
+		std::deque<GridNode*> path;
+	};
+	typedef std::list<Entry> EntryList;
+	EntryList entries;									// most recently used first
+	std::unordered_map<long long, EntryList::iterator> index;	// entries by key
+	unsigned int capacity;				// most paths kept
+	unsigned long hits;					// lookups answered from the cache
+	unsigned long misses;				// lookups that had to search
+
+	long long keyOf(int start, int goal) { return ((long long)start << 32) | (unsigned int)goal; }
+public:
+	PathCache(unsigned int capacity = PATH_CACHE_SIZE);
+	bool find(int start, int goal, int mode, int revision, std::deque<GridNode*>& path);	// copy a cached path out, false on a miss
+	void store(int start, int goal, int mode, int revision, const std::deque<GridNode*>& path);	// remember a path, dropping the least recently used
+	void clear();							// forget every path, keep the counters
+	unsigned long getHits() { return hits; }
+	unsigned long getMisses() { return misses; }
 };
 
 class Grid {
 private:
+#ifndef HEADLESS
 	Ogre::SceneManager* mSceneMgr;	// pointer to scene graph
-	std::vector<GridRow> data;		// actually hold the grid data
+#endif
+	friend class GridNode;			// a node is its place in nodes, and its walkability is in walkable
+	std::vector<GridNode> nodes;	// actually hold the grid data, row by row: node ID = index
+	std::vector<unsigned char> walkable;	// 1 if the node is clear, by node ID
+	Bitboard walkBits;				// the same a bit per node, for floods that go a word at a time
+#ifndef HEADLESS
+	std::unordered_map<int, Ogre::Entity*> entities;	// model placed on a node by loadObject, by node ID (few nodes have one)
+#endif
+	std::vector<unsigned char> moves;	// bit d set if the move in direction d (getAllNeighbors order) can be made from the node, by node ID
+	int moveOffset[8];				// node ID step in each direction
+	std::vector<int> componentParent;	// union-find over the clear nodes by node ID, a root is its own parent, -1 = blocked
+	std::vector<int> floodStack;		// scratch for labelComponents, rows the flood has still to hand on
+	Bitboard areaBits;					// scratch for labelComponents: the area being flooded
+	Bitboard unlabeledBits;				// and the clear nodes no flood has reached yet
+	bool componentsDirty;				// a node was blocked since the last labelling, components may have split
 	std::string levelName;				
 	int nRows;						// number of rows
 	int nCols;						// number of columns
 
-	std::vector<std::vector<int>> fCosts;			// f = g + h
-	std::vector<std::vector<int>> gCosts;			// cost to move to node so far
-	std::vector<std::vector<int>> hCosts;			// heuristic: manhattan distance
-	std::vector<std::vector<int>> whichList;		// on open/closed list?
-	std::vector<std::vector<GridNode*>> parents;	// parents of each node
+	SearchContext* mainContext;			// scratch for the searches not given a context, main thread only
+	PathCache pathCache;				// paths found before, reused until the walkability changes
+	std::mutex cacheLock;				// every search shares the path cache, nothing else
+	int revision;						// bumped whenever a node's walkability changes
+	std::vector<int> changes;			// node ID of every walkability change a reader may still need, changes[i] made revision changesBase + i + 1
+	int changesBase;					// revision before the oldest change kept
+	int changesTrimAt;					// log length that triggers the next trimChanges
+	std::vector<int> changeReaders;		// revision each reader of the log has caught up to (-1 = slot free)
+	std::vector<int> freeReaders;		// free slots in changeReaders
+	std::vector<FlowField*> flowFields;	// fields to recent goals, most recently asked for first
+	SearchMode searchMode;				// what findPath uses
+	bool printSearches;					// trace the debug grid of every aStar?
+#ifdef SEARCH_TRACE
+	SearchTrace* trace;					// aStar's debug grids, written out on another thread (NULL until the first)
+#endif
+
+	std::vector<int> jumpTable;			// JPS+ steps to the next jump point (> 0) or the wall (<= 0), 8 per node
+	int jumpTableRevision;				// grid revision the table was built on (-1 = not built)
+	PathHierarchy* hierarchy;			// clusters and entrances for SEARCH_HPA (NULL = not built)
+
+	bool isClearAt(int r, int c);		// is (r,c) on the grid and walkable
+	void setWalkable(int id, bool clear);	// GridNode's setClear and setOccupied
+	unsigned char findMoves(int r, int c);	// work out the move bits of (r,c)
+	void findAllMoves();				// the same for every node at once, from walkBits
+	void updateMoves(int r, int c);		// (r,c) changed: redo the move bits of it and the nodes around it
+	GridNode* neighborOf(GridNode* n, int dir);	// n's neighbor in direction dir, NULL if the move can't be made
+	void labelComponents();				// flood fill every clear node into its component
+	int findComponent(int id);			// root of id's set (-1 for a blocked node)
+	void joinComponents(int a, int b);
+	int jumpStraight(int r, int c, int dr, int dc, int goal);	// JPS: first jump point from (r,c) on, going (dr,dc)
+	int jumpDiagonal(int r, int c, int dr, int dc, int goal);
+	int jumpPlus(int r, int c, int dir, int goal);				// JPS+: same, from the table
+	int jumpDirections(int r, int c, int parent, int dirs[8]);	// JPS: directions worth searching from (r,c), given where we came from
 public:
+#ifdef HEADLESS
+	Grid(int numRows, int numCols);	// create a grid
+#else
 	Grid(Ogre::SceneManager* mSceneMgr, int numRows, int numCols);	// create a grid
+#endif
 	~Grid();					// destroy a grid
 
 	GridNode* getNode(int r, int c);  // get the node specified 
+	GridNode* getNodeByID(int id);    // get the node with the given ID
 
 	GridNode* getNorthNode(GridNode* n);	// get adjacent nodes;
 	GridNode* getSouthNode(GridNode* n);
@@ -76,19 +202,91 @@ public:
 	GridNode* getSENode(GridNode* n);
 	GridNode* getSWNode(GridNode* n);
 	std::vector<GridNode*> getAllNeighbors(GridNode* n);
+	void getNeighbors(GridNode* n, GridNode* neighbors[8]);	// same as getAllNeighbors, into the caller's array (no allocation)
+	unsigned char getMoves(int id) { return moves[id]; }	// bit d set if the move in direction d can be made from node id
+	int getMoveOffset(int dir) { return moveOffset[dir]; }	// add to a node ID to step in direction dir
 
 	int getDistance(GridNode* node1, GridNode* node2);  // get Manhattan distance between between two nodes
-	Ogre::Vector3 getPosition(int r, int c);			// return the position  
+	Vector3 getPosition(int r, int c);			// return the position  
 	
 	int getNumRows();	//return number of rows in grid
 	int getNumCols();	//return number of columns in grid
 
 	void setName(std::string name);	//set the name of the grid level
+	std::string getName() { return levelName; }
+	std::string debugFileName(std::string suffix);	//next to Grid.cpp, named for the level
 	void printToFile();				// Print a grid to a file.  Good for debugging
+#ifndef HEADLESS
 	void loadObject(std::string name, std::string filename, int row, int height, int col, float scale = 1); // load and place a model in a certain location.
+	Ogre::Entity* getEntity(GridNode* n);	// model loadObject placed on n, NULL if none
+#endif
 
-	std::deque<GridNode*> aStar(GridNode* start, GridNode* end);	//return optimal path from start to end
+	// Searches only read the grid. The ones given a SearchContext can run on
+	// any number of threads at once (one context each), as long as nobody
+	// changes the grid meanwhile; the ones without use the grid's own, so
+	// they are for the main thread.
+	std::deque<GridNode*> aStar(GridNode* start, GridNode* end);	//return optimal path from start to end (and draw it on the debug grid)
+	std::deque<GridNode*> aStar(GridNode* start, GridNode* end, SearchContext& context);
+	std::deque<GridNode*> jumpPointSearch(GridNode* start, GridNode* end, bool usePlus = false);	//optimal path from start to end, JPS or JPS+
+	std::deque<GridNode*> jumpPointSearch(GridNode* start, GridNode* end, bool usePlus, SearchContext& context);
+	std::deque<GridNode*> hierarchicalSearch(GridNode* start, GridNode* end);	//near optimal path from start to end, HPA*
+	std::deque<GridNode*> hierarchicalSearch(GridNode* start, GridNode* end, SearchContext& context);
+	std::deque<GridNode*> findPath(GridNode* start, GridNode* end);	//search with the grid's mode, answered from the path cache when it can be
+	std::deque<GridNode*> findPath(GridNode* start, GridNode* end, SearchMode mode);	//same, with the given mode
+	std::deque<GridNode*> findPath(GridNode* start, GridNode* end, SearchMode mode, SearchContext& context);
+	std::deque<GridNode*> search(GridNode* start, GridNode* end, SearchMode mode, SearchContext& context);	//findPath without the path cache
+	void findPaths(const std::vector<PathQuery>& queries, PathBatch& result, JobSystem* jobs);	//search them all with the grid's mode, spread over jobs' threads (see PathBatch)
+	void buildJumpTable();				//precompute the JPS+ jump distances, 32 bytes a node (done by the first JPS+ search on the main thread, and by prepareSearches while JPS+ is the mode)
+	void loadLevel(const LevelFile& level);	//a new grid's walls, and the areas and HPA clusters if the level has them baked (built if not)
+	void bakeNavigation(std::vector<int>& components, std::vector<int>& clusters);	//what loadLevel can take instead of working out (LevelCompile)
+	void buildHierarchy();				//cluster the grid for hierarchical searches (done at level load, relinked by prepareSearches)
+	void prepareSearches();				//after changes: bring the JPS+ table, the hierarchy and the areas up to date. Nothing may be searching
+	bool needsPreparing();				//changed since the last prepareSearches (until then JPS+ runs as JPS and HPA* as A*)
+	int getPathCost(GridNode* start, const std::deque<GridNode*>& path);	//total move cost of a path from start
+	void setSearchMode(SearchMode mode) { searchMode = mode; }
+	SearchMode getSearchMode() { return searchMode; }
+	void setPrintSearches(bool print) { printSearches = print; }	//turn the per-search debug trace on or off (debug builds only, see SearchTrace)
+	FlowField* flowTo(GridNode* goal);	//flow field leading to goal, built or rebuilt only when needed
+
+	void walkabilityChanged(GridNode* n);	//n was cleared or blocked, cached paths are stale
+	void trimChanges();					//drop the logged changes every reader has taken in
+	int getRevision() { return revision; }		//return the walkability revision
+	const Bitboard& getWalkBits() { return walkBits; }	//a bit per walkable node (SearchTrace writes it out as is)
+	int getChangedNode(int rev) { return changes[rev - changesBase - 1]; }	//node ID whose change made revision rev, past what the reader asking has caughtUp to
+	int followChanges();				//start reading the change log (incremental planners, DStarLite), caught up to now; returns the reader
+	void caughtUp(int reader, int rev) { changeReaders[reader] = rev; }	//reader has taken in the changes up to rev, the log can let them go
+	void unfollowChanges(int reader);
+	int getComponent(GridNode* n);		//label of the area n is in, the same for every node reachable from it (-1 if blocked). Main thread
+	bool isReachable(GridNode* from, GridNode* to);	//can a path be found from from to to? O(1) while nothing is blocked. Main thread
+	GridNode* nearestReachable(GridNode* from, GridNode* goal);	//goal if it can be reached from from, else the closest node to it that can (NULL if none)
+	unsigned long getPathCacheHits() { return pathCache.getHits(); }
+	unsigned long getPathCacheMisses() { return pathCache.getMisses(); }
 	
 };
 
+// these are hit in every search, so they go inline
+inline int
+GridNode::getID()
+{
+	return (int)(this - grid->nodes.data());
+}
+
+inline int
+GridNode::getRow()
+{
+	return getID() / grid->nCols;
+}
+
+inline int
+GridNode::getColumn()
+{
+	return getID() % grid->nCols;
+}
+
+inline bool
+GridNode::isClear()
+{
+	return grid->walkable[getID()] != 0;
+}
+
 //#endif
\ No newline at end of file
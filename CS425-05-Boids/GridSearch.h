@@ -0,0 +1,171 @@
+////////////////////////////////////////////////////////
+// A* with its choices made at compile time
+// GridSearch<Heuristic, Connectivity, Cost> is one search loop for every
+// combination of estimate (Manhattan, octile, Chebyshev or none at all,
+// which makes it Dijkstra), 4 or 8 way moves, and int or float costs.
+// The policies are tiny structs of static functions, so each combination
+// gets its own copy of the loop with the estimate inlined and the move
+// costs folded into constants, instead of a switch in every expansion.
+// ClassicSearch (Manhattan, 8 way, int) is what Grid::aStar has always
+// done: the same costs, the same ties, so the same paths.
+// Like SlicedSearch, a search object keeps its own scratch space, so
+// several can search one grid at once as long as nobody changes it.
+
+#pragma once
+#include <vector>
+#include <deque>
+#include <cstdlib>
+#include <algorithm>
+#include "Grid.h"
+
+// move costs ---------------------------------------------------------
+struct IntCost {		// the grid's own: NODESIZE straight, the diagonal rounded down (14)
+	typedef int Type;
+	static int straight() { return (int)NODESIZE; }
+	static int diagonal() { return (int)(NODESIZE * 1.41421356); }
+};
+
+struct FloatCost {		// the diagonal as it really is
+	typedef float Type;
+	static float straight() { return (float)NODESIZE; }
+	static float diagonal() { return (float)(NODESIZE * 1.41421356); }
+};
+
+// estimates, from dR rows and dC columns away --------------------------
+struct ManhattanHeuristic {		// Grid::getDistance, overestimates when diagonals are allowed
+	template <class Cost>
+	static typename Cost::Type estimate(int dR, int dC) { return (dR + dC) * Cost::straight(); }
+};
+
+struct OctileHeuristic {		// exact on an open grid with 8 way moves
+	template <class Cost>
+	static typename Cost::Type estimate(int dR, int dC)
+	{
+		return std::max(dR, dC) * Cost::straight() + std::min(dR, dC) * (Cost::diagonal() - Cost::straight());
+	}
+};
+
+struct ChebyshevHeuristic {		// as if diagonals cost the same as straight moves
+	template <class Cost>
+	static typename Cost::Type estimate(int dR, int dC) { return std::max(dR, dC) * Cost::straight(); }
+};
+
+struct ZeroHeuristic {			// no estimate, Dijkstra
+	template <class Cost>
+	static typename Cost::Type estimate(int, int) { return 0; }
+};
+
+// moves, as the first this many directions of the grid's move masks ----
+struct FourConnected {
+	static const int directions = 4;	// N, S, E, W
+};
+
+struct EightConnected {
+	static const int directions = 8;	// and NE, NW, SE, SW
+};
+
+template <class Heuristic, class Connectivity, class Cost>
+class GridSearch
+{
+public:
+	typedef typename Cost::Type CostType;
+
+private:
+	struct Record {			// SearchNode, in the search's cost type
+		CostType fCost;
+		CostType gCost;
+		int whichList;		// listMarker: closed, listMarker - 1: open, anything else: neither
+		int parent;			// node ID (-1 = none)
+	};
+
+	Grid* grid;
+	std::vector<Record> records;		// by node ID
+	BasicOpenList<CostType> openList;
+	int listMarker;
+	int expansions;				// nodes closed by the last search
+
+	CostType estimate(int node, int goalRow, int goalCol, int nCols)
+	{
+		return Heuristic::template estimate<Cost>(std::abs(node / nCols - goalRow), std::abs(node % nCols - goalCol));
+	}
+
+public:
+	GridSearch() : grid(NULL), listMarker(0), expansions(0) {}
+
+	std::deque<GridNode*> findPath(Grid* g, GridNode* start, GridNode* goal);	// start left off, goal included, empty if there is no path
+	int getExpansions() { return expansions; }
+	bool isOpen(int id) { return records[id].whichList == listMarker - 1; }	// how the last search left node id
+	bool isClosed(int id) { return records[id].whichList == listMarker; }
+};
+
+typedef GridSearch<ManhattanHeuristic, EightConnected, IntCost> ClassicSearch;	// Grid::aStar
+
+////////////////////////////////////////////////////////////////
+// the start is closed before anything is expanded and the search ends
+// when the goal is closed, the same order of events as the original aStar
+template <class Heuristic, class Connectivity, class Cost>
+std::deque<GridNode*>
+GridSearch<Heuristic, Connectivity, Cost>::findPath(Grid* g, GridNode* start, GridNode* goal)
+{
+	std::deque<GridNode*> path;
+	int numNodes = g->getNumRows() * g->getNumCols();
+	if (grid != g || (int)records.size() != numNodes)
+	{
+		Record blank = { 0, 0, 0, -1 };
+		records.assign(numNodes, blank);
+		openList.resize(numNodes);
+		listMarker = 0;
+	}
+	grid = g;
+	listMarker += 2;	// old list values are obsolete
+	openList.clear();
+	expansions = 0;
+
+	int nCols = g->getNumCols();
+	int goalID = goal->getID();
+	int goalRow = goal->getRow();
+	int goalCol = goal->getColumn();
+	int current = start->getID();
+	records[current].whichList = listMarker;
+	records[current].gCost = 0;
+	records[current].parent = -1;
+	expansions++;
+
+	while (records[goalID].whichList != listMarker)
+	{
+		unsigned char moves = g->getMoves(current);
+		for (int i = 0; i < Connectivity::directions; i++)
+		{
+			if (!(moves & (1 << i))) { continue; }
+			int id = current + g->getMoveOffset(i);
+			Record& neighbor = records[id];
+			if (neighbor.whichList == listMarker) { continue; }	// closed
+
+			CostType new_gCost = records[current].gCost + (i < 4 ? Cost::straight() : Cost::diagonal());
+			if (neighbor.whichList != listMarker - 1)
+			{
+				neighbor.whichList = listMarker - 1;
+				neighbor.gCost = new_gCost;
+				neighbor.parent = current;
+				neighbor.fCost = new_gCost + estimate(id, goalRow, goalCol, nCols);
+				openList.push(id, neighbor.fCost);
+			}
+			else if (new_gCost < neighbor.gCost)
+			{
+				neighbor.gCost = new_gCost;
+				neighbor.parent = current;
+				neighbor.fCost = new_gCost + estimate(id, goalRow, goalCol, nCols);
+				openList.decreaseKey(id, neighbor.fCost);
+			}
+		}
+
+		if (openList.empty()) { return path; }	// no path
+		current = openList.pop();
+		records[current].whichList = listMarker;
+		expansions++;
+	}
+
+	for (int node = goalID; node != start->getID(); node = records[node].parent)
+		path.push_front(g->getNodeByID(node));
+	return path;
+}
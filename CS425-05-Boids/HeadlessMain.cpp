@@ -0,0 +1,376 @@
+////////////////////////////////////////////////////////
+// Headless driver: loads a level into a Simulation with no
+// Ogre, no window and no input, steps it at a fixed rate and
+// prints how long that took. Built by CMakeLists.txt with
+// HEADLESS defined, for load tests on machines without a GPU.
+//
+//   boids_headless [level] [-agents N] [-steps N] [-dt seconds | -hz N]
+//                  [-threads N] [-paths N] [-seed N] [-grid RxC] [-flow | -move | -plan]
+//                  [-paththreads N] [-obstacles N] [-snap]
+//
+// -flow sends everyone to the first goal along one shared flow field
+// instead of walking the flock through the goals. -move sends everyone
+// to a random node by A* instead, through the same moveAgents as the
+// game's Left Ctrl, with the searches on the path service. Paths arrive
+// whenever the workers get to them, so with -move the checksum isn't the
+// same from run to run, unless -paththreads 0 has the searches time
+// sliced into the steps.
+// Goals that can't be reached are turned down without a search, -snap
+// sends those agents to the nearest node that can be instead.
+// -plan sends everyone to the first goal on their own D* Lite plan, like
+// the game's P, and -obstacles blocks or clears that many random nodes
+// before every step (the game's O) so the plans have something to repair.
+// -grid skips the level file and uses an open grid of that size,
+// big enough levels for 100k agents don't come with the game.
+// A level ending in .lvb is a compiled one (level_compile, LevelFile.h),
+// mapped and loaded in one go instead of read a node at a time.
+
+#include "Simulation.h"
+#include "Agent.h"
+#include "Grid.h"
+#include "AllocCounter.h"
+#include "LevelFile.h"
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <map>
+#include <algorithm>
+
+struct HeadlessOptions {
+	std::string level;	// level file, same format the game loads
+	int agents;			// fill the level up to this many agents (0: only the level's own)
+	int steps;			// number of fixed steps to run
+	float dt;			// seconds per step
+	int threads;		// threads for the agent update (0: one per core)
+	int paths;			// searches to time (A*, JPS, JPS+, HPA* and the GridSearch configurations) after the run (0: none)
+	int batch;			// queries to time one by one and as a batch after the run (0: none)
+	unsigned int seed;	// for the extra agents and random goals
+	int gridRows;		// open grid instead of a level file (0: use the level)
+	int gridCols;
+	bool flow;			// follow a flow field to the first goal instead of the flocking demo
+	bool move;			// moveTo a random node instead of the flocking demo
+	bool plan;			// planTo the first goal instead of the flocking demo
+	int obstacles;		// nodes to block or clear before every step
+	bool snap;			// -move: unreachable goals go to the nearest reachable node instead of nowhere
+	int pathThreads;	// path service workers (0: time sliced on the main thread)
+};
+
+//////////////////////////////////////////////////////////////////
+// read the grid and the agents out of a level file.
+// objects and walls only block their node, there is nothing to draw.
+// goal markers ('g') are returned in the order the game's demo walks them.
+static bool
+loadLevel(Simulation& sim, const std::string& path, std::deque<GridNode*>& goals)
+{
+	using namespace std;
+
+	ifstream inputfile(path.c_str());
+	if (!inputfile.is_open()) // oops. there was a problem opening the file
+	{
+		cout << "ERROR, FILE COULD NOT BE OPENED: " << path << endl;
+		return false;
+	}
+
+	int x, z;
+	inputfile >> x >> z;	// read in the dimensions of the grid
+	string matName;
+	inputfile >> matName;	// the floor material, unused here
+
+	Grid* grid = new Grid(z, x);	// z is rows, x is columns
+	grid->setName(path.substr(path.find_last_of("/\\") + 1));
+	sim.setGrid(grid);
+
+	string buf;
+	while (inputfile >> buf && buf != "Objects") {}
+	if (buf != "Objects")	// Oops, the file must not be formated correctly
+	{
+		cout << "ERROR: Level file error" << endl;
+		return false;
+	}
+
+	map<char, float> agentHeights;	// character symbol -> height above the floor
+	map<char, bool> objects;		// object symbols
+	string filename;
+	float y, orient, scale;
+	while (inputfile >> buf && buf != "Characters")
+	{
+		inputfile >> filename >> y >> orient >> scale;
+		objects[buf[0]] = true;
+	}
+	while (inputfile >> buf && buf != "World")
+	{
+		inputfile >> filename >> y >> scale;
+		agentHeights[buf[0]] = y;
+	}
+
+	char c;
+	for (int i = 0; i < z; i++)			// down (row)
+		for (int j = 0; j < x; j++)		// across (column)
+		{
+			if (!(inputfile >> c)) { grid->buildHierarchy(); return true; }	// short map, leave the rest open
+			if (agentHeights.count(c))
+			{
+				Agent* agent = new Agent(&sim, agentHeights[c], 1);
+				sim.addAgent(agent);
+				agent->setPosition(grid->getPosition(i,j).x, agentHeights[c], grid->getPosition(i,j).z);
+				agent->setGrid(grid);
+				agent->claimNode(grid->getNode(i,j));
+			}
+			else if (objects.count(c) || c == 'w')
+				grid->getNode(i,j)->setOccupied();
+			else if (c == 'g')
+				goals.push_back(grid->getNode(i,j));
+		}
+	grid->buildHierarchy();
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////
+// same from a compiled level: the walls, areas and clusters go into the
+// grid in one go, only the agents and goals are placed one at a time
+static bool
+loadCompiledLevel(Simulation& sim, const std::string& path, std::deque<GridNode*>& goals)
+{
+	LevelFile level;
+	if (!level.open(path))
+	{
+		std::cout << "ERROR, FILE COULD NOT BE OPENED: " << path << std::endl;
+		return false;
+	}
+
+	Grid* grid = new Grid(level.getNumRows(), level.getNumCols());
+	grid->setName(path.substr(path.find_last_of("/\\") + 1));
+	sim.setGrid(grid);
+	grid->loadLevel(level);
+	for (int i = 0; i < level.getNumSpawns(); i++)
+	{
+		const LevelSpawn& spawn = level.getSpawn(i);
+		const LevelType& type = level.getType(spawn.type);
+		GridNode* n = grid->getNodeByID(spawn.node);
+		if (type.kind == LEVEL_AGENT)
+		{
+			Agent* agent = new Agent(&sim, type.y, 1);
+			sim.addAgent(agent);
+			agent->setPosition(grid->getPosition(n->getRow(), n->getColumn()).x, type.y, grid->getPosition(n->getRow(), n->getColumn()).z);
+			agent->setGrid(grid);
+			agent->claimNode(n);
+		}
+		else if (type.kind == LEVEL_GOAL)
+			goals.push_back(n);
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////
+// add agents on random open nodes until there are count of them.
+// each one is jittered inside its node so no two start on the same spot
+static void
+addAgents(Simulation& sim, int count, float height)
+{
+	Grid* grid = sim.getGrid();
+	while ((int)sim.getAgentList().size() < count)
+	{
+		int r = rand() % grid->getNumRows();
+		int c = rand() % grid->getNumCols();
+		GridNode* n = grid->getNode(r, c);
+		if (!n->isClear()) { continue; }
+
+		Vector3 pos = grid->getPosition(r, c);
+		pos.x += (rand() % 1000 / 1000.0f - 0.5f) * NODESIZE;
+		pos.z += (rand() % 1000 / 1000.0f - 0.5f) * NODESIZE;
+
+		Agent* agent = new Agent(&sim, height, 1);
+		sim.addAgent(agent);
+		agent->setPosition(pos.x, height, pos.z);
+		agent->setGrid(grid);
+		agent->claimNode(n);
+	}
+}
+
+static bool
+parseOptions(int argc, char* argv[], HeadlessOptions& opt)
+{
+	opt.level = "levelBoids_big.txt";
+	opt.agents = 0;
+	opt.steps = 1000;
+	opt.dt = 1.0f / 60.0f;
+	opt.threads = 0;
+	opt.paths = 0;
+	opt.batch = 0;
+	opt.seed = 1;
+	opt.gridRows = 0;
+	opt.gridCols = 0;
+	opt.flow = false;
+	opt.move = false;
+	opt.plan = false;
+	opt.obstacles = 0;
+	opt.snap = false;
+	opt.pathThreads = PATH_THREADS;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (argv[i][0] != '-') { opt.level = argv[i]; }
+		else if (hasValue && strcmp(argv[i], "-agents") == 0) { opt.agents = atoi(argv[++i]); }
+		else if (hasValue && strcmp(argv[i], "-steps") == 0) { opt.steps = atoi(argv[++i]); }
+		else if (hasValue && strcmp(argv[i], "-dt") == 0) { opt.dt = (float)atof(argv[++i]); }
+		else if (hasValue && strcmp(argv[i], "-hz") == 0) { opt.dt = 1.0f / (float)atof(argv[++i]); }
+		else if (hasValue && strcmp(argv[i], "-threads") == 0) { opt.threads = atoi(argv[++i]); }
+		else if (hasValue && strcmp(argv[i], "-paths") == 0) { opt.paths = atoi(argv[++i]); }
+		else if (hasValue && strcmp(argv[i], "-batch") == 0) { opt.batch = atoi(argv[++i]); }
+		else if (hasValue && strcmp(argv[i], "-seed") == 0) { opt.seed = atoi(argv[++i]); }
+		else if (strcmp(argv[i], "-flow") == 0) { opt.flow = true; }
+		else if (strcmp(argv[i], "-move") == 0) { opt.move = true; }
+		else if (strcmp(argv[i], "-plan") == 0) { opt.plan = true; }
+		else if (hasValue && strcmp(argv[i], "-obstacles") == 0) { opt.obstacles = atoi(argv[++i]); }
+		else if (strcmp(argv[i], "-snap") == 0) { opt.snap = true; }
+		else if (hasValue && strcmp(argv[i], "-paththreads") == 0) { opt.pathThreads = atoi(argv[++i]); }
+		else if (hasValue && strcmp(argv[i], "-grid") == 0
+			&& sscanf(argv[++i], "%dx%d", &opt.gridRows, &opt.gridCols) == 2) {}
+		else
+		{
+			std::cout << "usage: " << argv[0] << " [level] [-agents N] [-steps N] [-dt seconds | -hz N]"
+				<< " [-threads N] [-paths N] [-batch N] [-seed N] [-grid RxC] [-flow | -move | -plan] [-paththreads N] [-obstacles N] [-snap]" << std::endl;
+			return false;
+		}
+	}
+	if ((int)opt.flow + (int)opt.move + (int)opt.plan > 1 || opt.obstacles < 0) { return false; }
+	if (opt.gridRows < 0 || opt.gridCols < 0 || (opt.gridRows > 0) != (opt.gridCols > 0)) { return false; }
+	return opt.dt > 0 && opt.dt == opt.dt;	//also rules out -hz 0 and junk
+}
+
+int main(int argc, char* argv[])
+{
+	HeadlessOptions opt;
+	if (!parseOptions(argc, argv, opt)) { return 1; }
+	srand(opt.seed);
+
+	Simulation sim(opt.threads);
+	if (opt.pathThreads != PATH_THREADS)
+		sim.setPathThreads(opt.pathThreads);
+	std::deque<GridNode*> goals;
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point loading = Clock::now();
+	if (opt.gridRows > 0)
+	{
+		opt.level = "open";
+		sim.setGrid(new Grid(opt.gridRows, opt.gridCols));
+		sim.getGrid()->setName(opt.level);
+		sim.getGrid()->buildHierarchy();
+	}
+	else
+	{
+		bool compiled = opt.level.size() > 4 && opt.level.compare(opt.level.size() - 4, 4, ".lvb") == 0;
+		if (!(compiled ? loadCompiledLevel(sim, opt.level, goals) : loadLevel(sim, opt.level, goals))) { return 1; }
+		std::cout << opt.level << ": loaded in " << std::chrono::duration<double>(Clock::now() - loading).count() * 1000.0 << " ms" << std::endl;
+	}
+	Grid* grid = sim.getGrid();
+
+	float height = sim.getAgentList().empty() ? 0.0f : sim.getAgentList()[0]->getPosition().y;
+	addAgents(sim, opt.agents, height);
+	const std::vector<Agent*>& agents = sim.getAgentList();
+	if (agents.empty())
+	{
+		std::cout << "ERROR: no agents to simulate" << std::endl;
+		return 1;
+	}
+
+	if (goals.empty())
+		goals.push_back(grid->getNode(rand() % grid->getNumRows(), rand() % grid->getNumCols()));
+	Clock::time_point queued;	//when -move handed its searches to the path service
+	if (opt.flow)	// the game's V key: everyone to one goal over a shared flow field
+	{
+		Clock::time_point swept = Clock::now();
+		sim.followFlow(goals[0]);
+		std::cout << "Flow field: " << std::chrono::duration<double>(Clock::now() - swept).count() * 1000.0
+			<< " ms to sweep the grid and send " << agents.size() << " agents" << std::endl;
+	}
+	else if (opt.move)	// the game's Left Ctrl: everyone to their own random node
+	{
+		sim.getGrid()->setPrintSearches(false);	//the debug grid is for one search at a time
+		queued = Clock::now();
+		int rejected = 0;	//goals turned down without a search
+		std::vector<GridNode*> targets;
+		for (unsigned int i = 0; i < agents.size(); i++)
+			targets.push_back(grid->getNode(rand() % grid->getNumRows(), rand() % grid->getNumCols()));
+		sim.moveAgents(targets, opt.snap);
+		for (unsigned int i = 0; i < agents.size(); i++)
+			if (!agents[i]->isWaitingForPath()) { rejected++; }
+		std::cout << "Path service: " << std::chrono::duration<double>(Clock::now() - queued).count() * 1000.0
+			<< " ms to queue " << sim.getPathService()->getNumPending() << " searches (" << rejected
+			<< " goals blocked or unreachable) on "
+			<< sim.getPathService()->getNumThreads() << " thread(s)" << std::endl;
+	}
+	else if (opt.plan)	// the game's P: everyone to one goal, each on their own incremental plan
+	{
+		Clock::time_point planned = Clock::now();
+		for (unsigned int i = 0; i < agents.size(); i++)
+			agents[i]->planTo(goals[0]);
+		std::cout << "D* Lite: " << std::chrono::duration<double>(Clock::now() - planned).count() * 1000.0
+			<< " ms to plan for " << agents.size() << " agents" << std::endl;
+	}
+	else	// same as the game's space bar in demo mode: one flock, walking the goal markers in order
+	{
+		agents[0]->toggleFlocking();
+		for (unsigned int g = 0; g < goals.size(); g++)
+			for (unsigned int i = 0; i < agents.size(); i++)
+				agents[i]->walkTo(goals[g]);
+	}
+
+	std::cout << opt.level << ": " << grid->getNumRows() << "x" << grid->getNumCols() << ", "
+		<< agents.size() << " agents, " << opt.steps << " steps of " << opt.dt << " s" << std::endl;
+
+	unsigned long allocations = 0;	//heap allocations made by the last step
+	double slowest = 0;				//longest step, ms
+	Clock::time_point began = Clock::now();
+	for (int i = 0; i < opt.steps; i++)
+	{
+		for (int o = 0; o < opt.obstacles; o++)	// the game's O, anywhere but the goal
+		{
+			GridNode* n = grid->getNode(rand() % grid->getNumRows(), rand() % grid->getNumCols());
+			if (n == goals[0]) { continue; }
+			sim.setWalkable(n, !n->isClear());
+		}
+		unsigned long before = getAllocationCount();
+		Clock::time_point stepped = Clock::now();
+		sim.step(opt.dt);
+		slowest = std::max(slowest, std::chrono::duration<double>(Clock::now() - stepped).count() * 1000.0);
+		allocations = getAllocationCount() - before;
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - began).count();
+
+	int waiting = 0;	//agents whose path hasn't come back
+	for (unsigned int i = 0; i < agents.size(); i++)
+		if (agents[i]->isWaitingForPath()) { waiting++; }
+
+	int flocking = 0;
+	double checksum = 0;	//same options and seed give the same sum, whatever the thread count
+	for (unsigned int i = 0; i < agents.size(); i++)
+	{
+		if (agents[i]->isFlocking()) { flocking++; }
+		Vector3 pos = agents[i]->getPosition();
+		checksum += pos.x + pos.y + pos.z;
+	}
+
+	std::cout << "Simulation: " << seconds * 1000.0 << " ms total, "
+		<< (opt.steps > 0 ? seconds * 1000.0 / opt.steps : 0.0) << " ms per step (slowest " << slowest << "), "
+		<< (seconds > 0 ? agents.size() * (double)opt.steps / seconds : 0.0) << " agent updates/s, "
+		<< flocking << " flocking, " << allocations << " allocations in the last step" << std::endl;
+	if (opt.move)
+	{
+		sim.getPathService()->wait();
+		std::cout << "Path service: " << waiting << " agents still waiting after the run, every search done "
+			<< std::chrono::duration<double>(Clock::now() - queued).count() * 1000.0 << " ms after queueing" << std::endl;
+	}
+	std::cout.precision(12);
+	std::cout << "Position checksum: " << checksum << std::endl;
+	std::cout.precision(6);
+
+	if (opt.paths > 0)
+		sim.benchmarkPaths(opt.paths);
+	if (opt.batch > 0)
+		sim.benchmarkBatch(opt.batch);
+	return 0;
+}
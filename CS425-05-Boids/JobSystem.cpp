@@ -0,0 +1,138 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////
+// start the workers. numThreads counts the calling thread too,
+// so a single core machine gets no workers and runs everything inline.
+JobSystem::JobSystem(int numThreads)
+{
+	if (numThreads <= 0)
+		numThreads = std::thread::hardware_concurrency();
+	if (numThreads <= 0)	// hardware_concurrency() is allowed to not know
+		numThreads = 1;
+
+	queued = 0;
+	unfinished = 0;
+	quit = false;
+	for (int i = 0; i < numThreads; i++)
+		queues.push_back(new WorkQueue());
+	for (int i = 1; i < numThreads; i++)
+		workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+////////////////////////////////////////////////////////////////
+// stop and join the workers
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> guard(wakeLock);
+		quit = true;
+	}
+	wake.notify_all();
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers[i].join();
+	for (unsigned int i = 0; i < queues.size(); i++)
+		delete queues[i];
+}
+
+void
+JobSystem::push(int queue, const Job& job)
+{
+	WorkQueue* q = queues[queue];
+	std::lock_guard<std::mutex> guard(q->lock);
+	if (q->top == q->bottom)	// empty, start over from the front
+		q->top = q->bottom = 0;
+	if (q->bottom == (int)q->jobs.size())
+		q->jobs.push_back(job);
+	else
+		q->jobs[q->bottom] = job;
+	q->bottom++;
+}
+
+bool
+JobSystem::popOwn(int queue, Job& job)
+{
+	WorkQueue* q = queues[queue];
+	std::lock_guard<std::mutex> guard(q->lock);
+	if (q->top == q->bottom) { return false; }
+	job = q->jobs[--q->bottom];
+	return true;
+}
+
+bool
+JobSystem::steal(int thief, Job& job)
+{
+	int n = queues.size();
+	for (int k = 1; k < n; k++)
+	{
+		WorkQueue* q = queues[(thief + k) % n];		// start with our neighbor so thieves spread out
+		std::lock_guard<std::mutex> guard(q->lock);
+		if (q->top == q->bottom) { continue; }
+		job = q->jobs[q->top++];
+		return true;
+	}
+	return false;
+}
+
+bool
+JobSystem::runOne(int queue)
+{
+	Job job;
+	if (!popOwn(queue, job) && !steal(queue, job)) { return false; }
+	queued--;
+	(*job.run)(job.begin, job.end);
+	unfinished--;
+	return true;
+}
+
+void
+JobSystem::workerLoop(int queue)
+{
+	for (;;)
+	{
+		while (runOne(queue)) {}
+
+		std::unique_lock<std::mutex> guard(wakeLock);
+		while (!quit && queued == 0)
+			wake.wait(guard);
+		if (quit) { return; }
+	}
+}
+
+////////////////////////////////////////////////////////////////
+// deal the batches out round robin, then help until every batch has run.
+// only one thread may be inside parallelFor at a time, and jobs must
+// not call it themselves.
+void
+JobSystem::parallelFor(int count, int batchSize, const RangeJob& run)
+{
+	if (count <= 0) { return; }
+	if (batchSize < 1) { batchSize = 1; }
+	if (queues.size() == 1 || count <= batchSize)	// nothing to share
+	{
+		run(0, count);
+		return;
+	}
+
+	int numBatches = (count + batchSize - 1) / batchSize;
+	unfinished += numBatches;
+	queued += numBatches;
+	for (int b = 0; b < numBatches; b++)
+	{
+		Job job;
+		job.run = &run;
+		job.begin = b * batchSize;
+		job.end = std::min(count, job.begin + batchSize);
+		push(b % queues.size(), job);
+	}
+	{
+		std::lock_guard<std::mutex> guard(wakeLock);	// so a worker can't miss the wakeup between its check and its wait
+	}
+	wake.notify_all();
+
+	while (unfinished > 0)
+	{
+		if (!runOne(0))
+			std::this_thread::yield();	// the last batches are running on other threads
+	}
+}
@@ -0,0 +1,62 @@
+////////////////////////////////////////////////////////
+// Small job system for splitting the agent update across cores.
+// One worker thread per core (the calling thread counts as one of them).
+// parallelFor() cuts a range into batches and deals them out to per-thread
+// queues; a thread that runs out of its own work steals from the others.
+// Jobs must not touch Ogre, the scene graph is main thread only.
+
+#pragma once
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class JobSystem
+{
+public:
+	typedef std::function<void (int begin, int end)> RangeJob;	// work on items [begin, end)
+
+private:
+	struct Job {
+		const RangeJob* run;
+		int begin;
+		int end;
+	};
+
+	// one per thread. the owner takes jobs from the bottom, thieves from the top.
+	// a lock per queue is plenty for the few dozen batches a frame makes.
+	struct WorkQueue {
+		std::mutex lock;
+		std::vector<Job> jobs;		// grows once to the biggest frame, then reused
+		int top;					// next job a thief takes
+		int bottom;					// one past the next job the owner takes
+
+		WorkQueue() : top(0), bottom(0) {};
+	};
+
+	std::vector<WorkQueue*> queues;		// queues[0] belongs to the thread calling parallelFor
+	std::vector<std::thread> workers;	// worker i runs queues[i + 1]
+	std::mutex wakeLock;
+	std::condition_variable wake;		// signalled when jobs are queued or on shutdown
+	std::atomic<int> queued;			// jobs sitting in queues
+	std::atomic<int> unfinished;		// jobs queued or running
+	bool quit;							// guarded by wakeLock
+
+	void push(int queue, const Job& job);
+	bool popOwn(int queue, Job& job);	// newest job from our own queue
+	bool steal(int thief, Job& job);	// oldest job from someone else's queue
+	bool runOne(int queue);				// run one job if there is any, false if every queue was empty
+	void workerLoop(int queue);
+
+public:
+	JobSystem(int numThreads = 0);	// 0: one thread per core
+	~JobSystem();
+
+	int getNumThreads() { return queues.size(); }	// workers plus the calling thread
+
+	// call run(begin, end) over [0, count) in batches of at most batchSize items,
+	// spread over every thread. Returns when all of them are done.
+	void parallelFor(int count, int batchSize, const RangeJob& run);
+};
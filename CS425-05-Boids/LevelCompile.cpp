@@ -0,0 +1,195 @@
+////////////////////////////////////////////////////////
+// Compiles a text level into the binary level the loaders map (LevelFile.h)
+//
+//   level_compile level.txt [out.lvb] [-lean]
+//
+// out is the level with .lvb in place of .txt unless given. -lean leaves
+// out the baked areas and HPA clusters, for a smaller file that the
+// loaders work those out for. The text is read the way the loaders read
+// it: columns, rows, floor material, then the Objects (symbol mesh y
+// orient scale), Characters (symbol mesh y scale) and World sections.
+// Compile again after editing the text level, the game and
+// boids_headless take a .lvb over the .txt.
+
+#include "Grid.h"
+#include "LevelFile.h"
+#include <fstream>
+#include <cstring>
+#include <chrono>
+
+static int
+addString(std::vector<char>& strings, const std::string& s)
+{
+	int at = strings.size();
+	strings.insert(strings.end(), s.begin(), s.end());
+	strings.push_back('\0');
+	return at;
+}
+
+static int
+addType(std::vector<LevelType>& types, int symbol, int kind, int mesh, float y, float orient, float scale)
+{
+	LevelType t;
+	t.symbol = symbol;
+	t.kind = kind;
+	t.mesh = mesh;
+	t.y = y;
+	t.orient = orient;
+	t.scale = scale;
+	types.push_back(t);
+	return types.size() - 1;
+}
+
+int main(int argc, char* argv[])
+{
+	using namespace std;
+
+	string path, outPath;
+	bool lean = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-lean") == 0) { lean = true; }
+		else if (path.empty()) { path = argv[i]; }
+		else if (outPath.empty()) { outPath = argv[i]; }
+		else { path.clear(); break; }
+	}
+	if (path.empty())
+	{
+		cout << "usage: " << argv[0] << " <level.txt> [out.lvb] [-lean]" << endl;
+		return 1;
+	}
+	if (outPath.empty())
+	{
+		size_t dot = path.find_last_of('.');
+		outPath = (dot == string::npos || path.find_first_of("/\\", dot) != string::npos ? path : path.substr(0, dot)) + ".lvb";
+	}
+	chrono::steady_clock::time_point began = chrono::steady_clock::now();
+
+	ifstream inputfile(path.c_str());
+	if (!inputfile.is_open())
+	{
+		cout << "ERROR, FILE COULD NOT BE OPENED: " << path << endl;
+		return 1;
+	}
+	int x, z;
+	string matName;
+	if (!(inputfile >> x >> z >> matName) || x <= 0 || z <= 0)	// z is rows, x is columns
+	{
+		cout << "ERROR: Level file error" << endl;
+		return 1;
+	}
+
+	vector<char> strings;
+	vector<LevelType> types;
+	int typeOf[256];	// map symbol -> type, -1 = open ground
+	for (int i = 0; i < 256; i++)
+		typeOf[i] = -1;
+	int material = addString(strings, matName);
+
+	string buf, filename;
+	float y, orient, scale;
+	while (inputfile >> buf && buf != "Objects") {}
+	if (buf != "Objects")
+	{
+		cout << "ERROR: Level file error" << endl;
+		return 1;
+	}
+	while (inputfile >> buf && buf != "Characters")
+	{
+		inputfile >> filename >> y >> orient >> scale;
+		typeOf[(unsigned char)buf[0]] = addType(types, buf[0], LEVEL_OBJECT, addString(strings, filename), y, orient, scale);
+	}
+	while (inputfile >> buf && buf != "World")
+	{
+		inputfile >> filename >> y >> scale;
+		typeOf[(unsigned char)buf[0]] = addType(types, buf[0], LEVEL_AGENT, addString(strings, filename), y, 0.0f, scale);
+	}
+	if (typeOf['w'] == -1) { typeOf['w'] = addType(types, 'w', LEVEL_WALL, -1, 0.0f, 0.0f, 1.0f); }	// the loaders look the symbol up before these
+	if (typeOf['e'] == -1) { typeOf['e'] = addType(types, 'e', LEVEL_FOUNTAIN, -1, 0.0f, 0.0f, 1.0f); }
+	if (typeOf['g'] == -1) { typeOf['g'] = addType(types, 'g', LEVEL_GOAL, -1, 0.0f, 0.0f, 1.0f); }
+
+	// the walls go into the plane and the grid, the grid is only for baking
+	Grid grid(z, x);
+	Bitboard plane;
+	plane.resize(z, x);
+	plane.fill();
+	vector<LevelSpawn> spawns;
+	char c;
+	for (int id = 0; id < z * x && inputfile >> c; id++)	// a short map leaves the rest open
+	{
+		int t = typeOf[(unsigned char)c];
+		if (t == -1) { continue; }
+		LevelSpawn s;
+		s.node = id;
+		s.type = t;
+		spawns.push_back(s);
+		if (types[t].kind == LEVEL_OBJECT || types[t].kind == LEVEL_WALL)
+		{
+			plane.clear(id);
+			grid.getNodeByID(id)->setOccupied();
+		}
+	}
+
+	vector<int> components, clusters;
+	if (!lean)
+		grid.bakeNavigation(components, clusters);
+
+	LevelHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = LEVEL_MAGIC;
+	header.version = LEVEL_VERSION;
+	header.rows = z;
+	header.cols = x;
+	header.material = material;
+	header.numTypes = types.size();
+	header.numSpawns = spawns.size();
+	const char* bytes[LEVEL_SECTIONS];
+	bytes[LEVEL_STRINGS] = &strings[0];
+	header.size[LEVEL_STRINGS] = strings.size();
+	bytes[LEVEL_TYPES] = types.empty() ? NULL : (const char*)&types[0];
+	header.size[LEVEL_TYPES] = types.size() * sizeof(LevelType);
+	bytes[LEVEL_SPAWNS] = spawns.empty() ? NULL : (const char*)&spawns[0];
+	header.size[LEVEL_SPAWNS] = spawns.size() * sizeof(LevelSpawn);
+	bytes[LEVEL_WALKABLE] = (const char*)plane.row(0);
+	header.size[LEVEL_WALKABLE] = (long long)z * plane.getRowWords() * sizeof(BitWord);
+	bytes[LEVEL_COMPONENTS] = components.empty() ? NULL : (const char*)&components[0];
+	header.size[LEVEL_COMPONENTS] = components.size() * sizeof(int);
+	bytes[LEVEL_CLUSTERS] = clusters.empty() ? NULL : (const char*)&clusters[0];
+	header.size[LEVEL_CLUSTERS] = clusters.size() * sizeof(int);
+	long long at = sizeof(header);
+	for (int s = 0; s < LEVEL_SECTIONS; s++)
+	{
+		if (header.size[s] == 0) { continue; }
+		at = (at + 7) / 8 * 8;
+		header.at[s] = at;
+		at += header.size[s];
+	}
+
+	ofstream out(outPath.c_str(), ios::out | ios::binary | ios::trunc);
+	if (!out.is_open())
+	{
+		cout << "ERROR, FILE COULD NOT BE OPENED: " << outPath << endl;
+		return 1;
+	}
+	out.write((const char*)&header, sizeof(header));
+	long long written = sizeof(header);
+	const char zeros[8] = { 0 };
+	for (int s = 0; s < LEVEL_SECTIONS; s++)
+	{
+		if (header.size[s] == 0) { continue; }
+		out.write(zeros, header.at[s] - written);
+		out.write(bytes[s], header.size[s]);
+		written = header.at[s] + header.size[s];
+	}
+	out.close();
+	if (!out)
+	{
+		cout << "ERROR, COULD NOT WRITE: " << outPath << endl;
+		return 1;
+	}
+
+	cout << path << " -> " << outPath << ": " << z << "x" << x << ", " << spawns.size() << " spawns, "
+		<< (lean ? "nothing baked" : "areas and HPA clusters baked") << ", " << written / 1024 << " KB in "
+		<< chrono::duration<double>(chrono::steady_clock::now() - began).count() << " s" << endl;
+	return 0;
+}
@@ -0,0 +1,123 @@
+#include "LevelFile.h"
+#include <iostream>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+LevelFile::LevelFile()
+{
+	data = NULL;
+	length = 0;
+#ifdef _WIN32
+	file = INVALID_HANDLE_VALUE;
+	mapping = NULL;
+#endif
+	header = NULL;
+}
+
+LevelFile::~LevelFile()
+{
+	close();
+}
+
+////////////////////////////////////////////////////////////////
+// a missing file is quietly false, the game tries for a compiled level
+// before the text one
+bool
+LevelFile::open(const std::string& path)
+{
+	close();
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) { return false; }
+	LARGE_INTEGER fileSize;
+	if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+	{
+		length = fileSize.QuadPart;
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping != NULL)
+			data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd == -1) { return false; }
+	struct stat info;
+	if (fstat(fd, &info) == 0 && info.st_size > 0)
+	{
+		length = info.st_size;
+		void* mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped != MAP_FAILED)
+			data = (const char*)mapped;
+	}
+	::close(fd);	// the mapping stays
+#endif
+	if (data == NULL)
+	{
+		std::cout << "ERROR, FILE COULD NOT BE MAPPED: " << path << std::endl;
+		close();
+		return false;
+	}
+	header = (const LevelHeader*)data;
+	if (!check(path))
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void
+LevelFile::close()
+{
+#ifdef _WIN32
+	if (data != NULL) { UnmapViewOfFile(data); }
+	if (mapping != NULL) { CloseHandle(mapping); }
+	if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (data != NULL) { munmap((void*)data, length); }
+#endif
+	data = NULL;
+	length = 0;
+	header = NULL;
+}
+
+////////////////////////////////////////////////////////////////
+// sizes first, then every offset and index the loaders follow. The
+// baked sections are checked by whoever takes them (Grid::loadLevel,
+// PathHierarchy::load), they know what adds up
+bool
+LevelFile::check(const std::string& path)
+{
+	bool good = length >= (long long)sizeof(LevelHeader) && header->magic == LEVEL_MAGIC && header->version == LEVEL_VERSION
+		&& header->rows > 0 && header->cols > 0 && (long long)header->rows * header->cols < (1LL << 31)
+		&& header->numTypes >= 0 && header->numSpawns >= 0;
+	for (int s = 0; good && s < LEVEL_SECTIONS; s++)
+		good = header->at[s] >= 0 && header->size[s] >= 0 && header->at[s] % 8 == 0 && header->at[s] <= length
+			&& header->size[s] <= length - header->at[s] && (header->at[s] != 0 || header->size[s] == 0);
+
+	long long numNodes = good ? (long long)header->rows * header->cols : 0;
+	long long rowWords = good ? (header->cols + 63) / 64 : 0;
+	long long numStrings = good ? header->size[LEVEL_STRINGS] : 0;
+	good = good && numStrings > 0 && getString(0)[numStrings - 1] == '\0'
+		&& header->size[LEVEL_TYPES] == header->numTypes * (long long)sizeof(LevelType)
+		&& header->size[LEVEL_SPAWNS] == header->numSpawns * (long long)sizeof(LevelSpawn)
+		&& header->at[LEVEL_WALKABLE] != 0 && header->size[LEVEL_WALKABLE] == header->rows * rowWords * (long long)sizeof(BitWord)
+		&& (header->at[LEVEL_COMPONENTS] == 0 || header->size[LEVEL_COMPONENTS] == numNodes * (long long)sizeof(int))
+		&& header->material >= 0 && header->material < numStrings;
+	for (int i = 0; good && i < header->numTypes; i++)
+		good = getType(i).kind >= LEVEL_AGENT && getType(i).kind <= LEVEL_GOAL && getType(i).mesh >= -1 && getType(i).mesh < numStrings;
+	for (int i = 0; good && i < header->numSpawns; i++)
+		good = getSpawn(i).node >= 0 && getSpawn(i).node < numNodes && getSpawn(i).type >= 0 && getSpawn(i).type < header->numTypes;
+	if (!good)
+		std::cout << "ERROR: Level file error, not a compiled level (or from another version): " << path << std::endl;
+	return good;
+}
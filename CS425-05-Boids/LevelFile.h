@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////
+// Compiled levels (.lvb)
+// The text levels are read a token at a time and every wall is a
+// setOccupied; past a few hundred nodes a side that, and linking the HPA
+// clusters, is most of the start up. level_compile (LevelCompile.cpp)
+// turns a text level into this instead: a header, then sections the
+// loaders use straight out of the mapped file, no parsing:
+//   strings     the floor material and mesh names, each ending in a 0
+//   types       one LevelType per map symbol that isn't open ground
+//   spawns      one LevelSpawn per node with something on it, row by row
+//               (the order the text loaders place things, so goals and
+//               agents come out in the same order)
+//   walkable    a bit per node, rows padded to whole 64 bit words, the
+//               layout of Bitboard, so it goes into the grid in one copy
+//   components  baked: Grid's area labels, an int per node
+//   clusters    baked: the linked HPA clusters (PathHierarchy::bake)
+// The baked sections can be left out (level_compile -lean), the grid
+// works them out then. The JPS+ table is never baked, at 32 bytes a
+// node it would be bigger than the rest of the file put together; the
+// first JPS+ search (or prepareSearches) builds it instead.
+// The file is written and read by the same code on the same machine, so
+// the sections are raw structs, in the machine's byte order.
+
+#pragma once
+#include <string>
+#include "Bitboard.h"
+
+#define LEVEL_MAGIC 0x3142564C	// "LVB1" read as a little endian int
+#define LEVEL_VERSION 1
+
+enum LevelKind {		// what a map symbol puts on its node
+	LEVEL_AGENT,		// a character, the rest of its type is its mesh
+	LEVEL_OBJECT,		// a mesh that blocks its node
+	LEVEL_WALL,			// 'w', a cube that blocks its node
+	LEVEL_FOUNTAIN,		// 'e', particles only
+	LEVEL_GOAL			// 'g', a marker the demo walks to in order
+};
+
+enum LevelSection {
+	LEVEL_STRINGS,
+	LEVEL_TYPES,
+	LEVEL_SPAWNS,
+	LEVEL_WALKABLE,
+	LEVEL_COMPONENTS,
+	LEVEL_CLUSTERS,
+	LEVEL_SECTIONS		// number of sections
+};
+
+struct LevelType {
+	int symbol;			// the character in the text level
+	int kind;			// LevelKind
+	int mesh;			// offset of the mesh file name in the strings (-1 = none)
+	float y;			// height above the floor
+	float orient;		// objects only
+	float scale;
+};
+
+struct LevelSpawn {
+	int node;			// node ID
+	int type;			// index into the types
+};
+
+struct LevelHeader {
+	int magic;			// LEVEL_MAGIC
+	int version;		// LEVEL_VERSION
+	int rows;
+	int cols;
+	int material;		// offset of the floor material in the strings
+	int numTypes;
+	int numSpawns;
+	int pad;
+	long long at[LEVEL_SECTIONS];	// byte offset of each section, a multiple of 8 (0 = not in the file)
+	long long size[LEVEL_SECTIONS];	// bytes in each section
+};
+
+class LevelFile
+{
+private:
+	const char* data;	// the whole file, mapped read only (NULL = nothing open)
+	long long length;
+#ifdef _WIN32
+	void* file;			// HANDLEs
+	void* mapping;
+#endif
+	const LevelHeader* header;
+
+	const void* section(int s) const { return header->at[s] == 0 ? NULL : data + header->at[s]; }
+	bool check(const std::string& path);	// everything an index or an offset points at is in the file
+
+public:
+	LevelFile();
+	~LevelFile();		// close()s
+
+	bool open(const std::string& path);		// map a compiled level; false if there is none, with a message if it isn't one
+	void close();
+
+	int getNumRows() const { return header->rows; }
+	int getNumCols() const { return header->cols; }
+	const char* getString(int offset) const { return (const char*)section(LEVEL_STRINGS) + offset; }
+	const char* getMaterial() const { return getString(header->material); }
+	int getNumTypes() const { return header->numTypes; }
+	const LevelType& getType(int i) const { return ((const LevelType*)section(LEVEL_TYPES))[i]; }
+	int getNumSpawns() const { return header->numSpawns; }
+	const LevelSpawn& getSpawn(int i) const { return ((const LevelSpawn*)section(LEVEL_SPAWNS))[i]; }
+	const BitWord* getWalkable() const { return (const BitWord*)section(LEVEL_WALKABLE); }
+	const int* getComponents() const { return (const int*)section(LEVEL_COMPONENTS); }	// NULL if not baked
+	const int* getClusters() const { return (const int*)section(LEVEL_CLUSTERS); }		// NULL if not baked
+	int getClustersSize() const { return (int)(header->size[LEVEL_CLUSTERS] / sizeof(int)); }	// ints in it
+};
@@ -0,0 +1,120 @@
+#include "PathBatch.h"
+#include "SearchContext.h"
+#include "JobSystem.h"
+#include <algorithm>
+
+PathBatch::PathBatch()
+{
+	nextSearch = 0;
+}
+
+PathBatch::~PathBatch()
+{
+	for (unsigned int i = 0; i < contexts.size(); i++)
+		delete contexts[i];
+}
+
+void
+PathBatch::clear()
+{
+	searches.clear();
+	querySearch.clear();
+	index.clear();
+	nodes.clear();
+}
+
+////////////////////////////////////////////////////////////////
+// a query the same as one before it is answered by the same search.
+// One with nothing to search (no start, or a blocked goal) still gets
+// its number, with an empty path
+int
+PathBatch::add(GridNode* start, GridNode* goal)
+{
+	long long key = -1;
+	if (start != NULL && goal != NULL && goal->isClear())
+	{
+		key = ((long long)start->getID() << 32) | (unsigned int)goal->getID();
+		std::unordered_map<long long, int>::iterator found = index.find(key);
+		if (found != index.end())
+		{
+			querySearch.push_back(found->second);
+			return querySearch.size() - 1;
+		}
+	}
+
+	Search s;
+	s.start = key == -1 ? NULL : start;	// NULL = nothing to search
+	s.goal = goal;
+	s.job = -1;
+	s.offset = 0;
+	s.length = 0;
+	if (key != -1)
+		index[key] = searches.size();
+	querySearch.push_back(searches.size());
+	searches.push_back(s);
+	return querySearch.size() - 1;
+}
+
+////////////////////////////////////////////////////////////////
+// each job writes only its own buffer and the searches it took, so the
+// jobs share nothing but the counter
+void
+PathBatch::runJob(Grid* grid, SearchMode mode, int job)
+{
+	std::vector<int>& buffer = jobNodes[job];
+	while (true)
+	{
+		int i = nextSearch++;
+		if (i >= (int)searches.size()) { return; }
+		Search& s = searches[i];
+		if (s.start == NULL) { continue; }
+
+		std::deque<GridNode*> path = grid->search(s.start, s.goal, mode, *contexts[job]);
+		s.job = job;
+		s.offset = buffer.size();
+		s.length = path.size();
+		for (unsigned int n = 0; n < path.size(); n++)
+			buffer.push_back(path[n]->getID());
+	}
+}
+
+////////////////////////////////////////////////////////////////
+// one job per thread rather than one per search: a job is a context
+// and a buffer, and the counter does the load balancing. Then the job
+// buffers are laid end to end in nodes
+void
+PathBatch::solve(Grid* grid, SearchMode mode, JobSystem* jobs)
+{
+	int numJobs = jobs == NULL ? 1 : jobs->getNumThreads();
+	numJobs = std::max(1, std::min(numJobs, (int)searches.size()));
+	while ((int)contexts.size() < numJobs)
+		contexts.push_back(new SearchContext());
+	if ((int)jobNodes.size() < numJobs)
+		jobNodes.resize(numJobs);
+	for (int j = 0; j < numJobs; j++)
+		jobNodes[j].clear();
+
+	nextSearch = 0;
+	if (jobs == NULL || numJobs == 1)
+		runJob(grid, mode, 0);
+	else
+		jobs->parallelFor(numJobs, 1, [this, grid, mode](int begin, int end)
+		{
+			for (int j = begin; j < end; j++)
+				runJob(grid, mode, j);
+		});
+
+	std::vector<int> base(numJobs, 0);	// where each job's buffer starts in nodes
+	int total = 0;
+	for (int j = 0; j < numJobs; j++)
+	{
+		base[j] = total;
+		total += jobNodes[j].size();
+	}
+	nodes.resize(total);
+	for (int j = 0; j < numJobs; j++)
+		std::copy(jobNodes[j].begin(), jobNodes[j].end(), nodes.begin() + base[j]);
+	for (unsigned int i = 0; i < searches.size(); i++)
+		if (searches[i].job != -1)
+			searches[i].offset += base[searches[i].job];
+}
@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////
+// Many searches on one grid at once, see Grid::findPaths
+// The queries are boiled down to the distinct (start, goal) pairs first,
+// so a crowd sent to the same node costs one search. The searches are
+// then spread over the job system's threads, each with its own
+// SearchContext, taking the next pair off a shared counter so a few long
+// searches don't hold one thread up while the others sit idle.
+// The paths all end up back to back in one buffer of node IDs; a query
+// is an offset and a length into it, and duplicates share the same path.
+// The contexts and buffers are kept for the next batch, so after the
+// first one a batch of the same size allocates next to nothing.
+
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include "Grid.h"
+
+class JobSystem;
+
+class PathBatch
+{
+private:
+	struct Search {			// one distinct (start, goal) pair
+		GridNode* start;
+		GridNode* goal;
+		int job;			// which job searched it, its path is in that job's buffer
+		int offset;			// where the path starts, in the job's buffer and then in nodes
+		int length;			// number of nodes on it (0 = no path)
+	};
+
+	std::vector<Search> searches;
+	std::vector<int> querySearch;		// search each query is answered by, in the order they were added
+	std::unordered_map<long long, int> index;	// searches by start and goal node IDs
+	std::vector<int> nodes;				// every path back to back: start left off, goal included
+	std::vector<SearchContext*> contexts;	// one per job
+	std::vector<std::vector<int> > jobNodes;	// paths as each job found them, copied into nodes at the end
+	std::atomic<int> nextSearch;		// next search a job takes
+
+	void runJob(Grid* grid, SearchMode mode, int job);	// search until there are none left
+
+public:
+	PathBatch();
+	~PathBatch();
+
+	void clear();								// forget the queries and paths, keep the space
+	int add(GridNode* start, GridNode* goal);	// queue a query, returns its number
+	void solve(Grid* grid, SearchMode mode, JobSystem* jobs);	// search every query (jobs NULL: on this thread)
+
+	int getNumQueries() { return querySearch.size(); }
+	int getNumSearches() { return searches.size(); }	// distinct queries
+	int getLength(int query) { return searches[querySearch[query]].length; }	// 0 if there is no path (or nothing to walk)
+	const int* getPath(int query) { return nodes.data() + searches[querySearch[query]].offset; }	// node IDs, getLength of them
+};
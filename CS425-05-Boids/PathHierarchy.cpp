@@ -0,0 +1,505 @@
+#include "PathHierarchy.h"
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+static const int diagonal_cost = sqrt(NODESIZE * NODESIZE + NODESIZE * NODESIZE);
+
+////////////////////////////////////////////////////////////////
+// octile distance between two nodes, never more than the real cost
+static int
+estimate(Grid* grid, int a, int b)
+{
+	int dR = std::abs(a / grid->getNumCols() - b / grid->getNumCols());
+	int dC = std::abs(a % grid->getNumCols() - b % grid->getNumCols());
+	return (int)NODESIZE * std::max(dR, dC) + (diagonal_cost - (int)NODESIZE) * std::min(dR, dC);
+}
+
+////////////////////////////////////////////////////////////////
+// walk length nodes of a cluster border from (r,c) in steps of
+// (stepR,stepC). The node across the border is (outR,outC) away.
+// Every stretch open on both sides gets an entrance in the middle,
+// or one at each end if it is long, so the cluster on the other side
+// finds the same entrances from its side
+static void
+scanBorder(Grid* grid, int r, int c, int stepR, int stepC, int length, int outR, int outC, std::vector<int>& found)
+{
+	int runStart = -1;
+	for (int i = 0; i <= length; i++)
+	{
+		bool open = i < length && grid->getNode(r + stepR * i, c + stepC * i)->isClear()
+			&& grid->getNode(r + stepR * i + outR, c + stepC * i + outC)->isClear();
+		if (open && runStart == -1) { runStart = i; }
+		if (open || runStart == -1) { continue; }
+
+		int runLength = i - runStart;	// stretch just ended
+		if (runLength < ENTRANCE_SPLIT)
+			found.push_back(runStart + (runLength - 1) / 2);
+		else
+		{
+			found.push_back(runStart);
+			found.push_back(i - 1);
+		}
+		runStart = -1;
+	}
+}
+
+PathHierarchy::PathHierarchy()
+{
+	clusterRows = 0;
+	clusterCols = 0;
+	anyDirty = false;
+	linking.fit(CLUSTER_SIZE * CLUSTER_SIZE);
+}
+
+PathHierarchy::~PathHierarchy()
+{}
+
+////////////////////////////////////////////////////////////////
+// cut the grid into clusters, find their entrances and link them up
+void
+PathHierarchy::build(Grid* grid)
+{
+	int nRows = grid->getNumRows();
+	int nCols = grid->getNumCols();
+	clusterRows = (nRows + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+	clusterCols = (nCols + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+	clusters.assign(clusterRows * clusterCols, Cluster());
+	for (int i = 0; i < clusterRows; i++)
+		for (int j = 0; j < clusterCols; j++)
+		{
+			Cluster& k = clusters[i * clusterCols + j];
+			k.top = i * CLUSTER_SIZE;
+			k.left = j * CLUSTER_SIZE;
+			k.rows = std::min(CLUSTER_SIZE, nRows - k.top);
+			k.cols = std::min(CLUSTER_SIZE, nCols - k.left);
+			k.dirty = true;
+		}
+	anyDirty = true;
+	update(grid);
+}
+
+////////////////////////////////////////////////////////////////
+// CLUSTER_SIZE, cluster rows, cluster columns, then where each cluster's
+// entrances start (and one past the last), every entrance as node and
+// across, and each cluster's costs in turn
+void
+PathHierarchy::bake(Grid* grid, std::vector<int>& out)
+{
+	update(grid);
+	out.clear();
+	out.push_back(CLUSTER_SIZE);
+	out.push_back(clusterRows);
+	out.push_back(clusterCols);
+	int first = 0;
+	for (unsigned int k = 0; k < clusters.size(); k++)
+	{
+		out.push_back(first);
+		first += clusters[k].entrances.size();
+	}
+	out.push_back(first);
+	for (unsigned int k = 0; k < clusters.size(); k++)
+		for (unsigned int i = 0; i < clusters[k].entrances.size(); i++)
+		{
+			out.push_back(clusters[k].entrances[i].node);
+			out.push_back(clusters[k].entrances[i].across);
+		}
+	for (unsigned int k = 0; k < clusters.size(); k++)
+		out.insert(out.end(), clusters[k].costs.begin(), clusters[k].costs.end());
+}
+
+////////////////////////////////////////////////////////////////
+// a bake from another CLUSTER_SIZE or another grid, or one that doesn't
+// add up, is turned down and the caller builds instead. The costs are
+// taken as they are, only entrances off the grid could do real harm
+bool
+PathHierarchy::load(Grid* grid, const int* baked, int count)
+{
+	int nRows = grid->getNumRows();
+	int nCols = grid->getNumCols();
+	int rowsDown = (nRows + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+	int colsAcross = (nCols + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+	int numClusters = rowsDown * colsAcross;
+	if (count < 4 + numClusters || baked[0] != CLUSTER_SIZE || baked[1] != rowsDown || baked[2] != colsAcross) { return false; }
+	const int* first = baked + 3;
+	long long numCosts = 0;
+	if (first[0] != 0) { return false; }
+	for (int k = 0; k < numClusters; k++)
+	{
+		long long n = first[k + 1] - first[k];
+		if (n < 0) { return false; }
+		numCosts += n * n;
+	}
+	if (4 + numClusters + 2LL * first[numClusters] + numCosts != count) { return false; }
+	const int* entrance = first + numClusters + 1;
+	const int* cost = entrance + 2 * first[numClusters];
+
+	clusterRows = rowsDown;
+	clusterCols = colsAcross;
+	clusters.assign(numClusters, Cluster());
+	for (int k = 0; k < numClusters; k++)
+	{
+		Cluster& cluster = clusters[k];
+		cluster.top = k / clusterCols * CLUSTER_SIZE;
+		cluster.left = k % clusterCols * CLUSTER_SIZE;
+		cluster.rows = std::min(CLUSTER_SIZE, nRows - cluster.top);
+		cluster.cols = std::min(CLUSTER_SIZE, nCols - cluster.left);
+		cluster.dirty = false;
+		int n = first[k + 1] - first[k];
+		cluster.entrances.resize(n);
+		for (int i = 0; i < n; i++, entrance += 2)
+		{
+			Entrance& e = cluster.entrances[i];
+			e.node = entrance[0];
+			e.across = entrance[1];
+			if (e.node < 0 || e.across < 0 || e.node >= nRows * nCols || e.across >= nRows * nCols
+				|| clusterOf(grid, e.node) != k
+				|| std::abs(e.node / nCols - e.across / nCols) + std::abs(e.node % nCols - e.across % nCols) != 1)
+			{
+				clusters.clear();
+				return false;
+			}
+		}
+		cluster.costs.assign(cost, cost + n * n);
+		cost += n * n;
+	}
+	anyDirty = false;
+	return true;
+}
+
+int
+PathHierarchy::clusterOf(Grid* grid, int node)
+{
+	int r = node / grid->getNumCols();
+	int c = node % grid->getNumCols();
+	return (r / CLUSTER_SIZE) * clusterCols + c / CLUSTER_SIZE;
+}
+
+////////////////////////////////////////////////////////////////
+// entrances on all four sides of cluster k that have a cluster next to them
+void
+PathHierarchy::findEntrances(Grid* grid, int k)
+{
+	Cluster& cluster = clusters[k];
+	int bottom = cluster.top + cluster.rows - 1;
+	int right = cluster.left + cluster.cols - 1;
+	cluster.entrances.clear();
+
+	std::vector<int> found;	// offsets along the side
+	Entrance e;
+	if (cluster.top > 0)	// north
+	{
+		found.clear();
+		scanBorder(grid, cluster.top, cluster.left, 0, 1, cluster.cols, -1, 0, found);
+		for (unsigned int i = 0; i < found.size(); i++)
+		{
+			e.node = grid->getNode(cluster.top, cluster.left + found[i])->getID();
+			e.across = grid->getNode(cluster.top - 1, cluster.left + found[i])->getID();
+			cluster.entrances.push_back(e);
+		}
+	}
+	if (bottom < grid->getNumRows() - 1)	// south
+	{
+		found.clear();
+		scanBorder(grid, bottom, cluster.left, 0, 1, cluster.cols, 1, 0, found);
+		for (unsigned int i = 0; i < found.size(); i++)
+		{
+			e.node = grid->getNode(bottom, cluster.left + found[i])->getID();
+			e.across = grid->getNode(bottom + 1, cluster.left + found[i])->getID();
+			cluster.entrances.push_back(e);
+		}
+	}
+	if (cluster.left > 0)	// west
+	{
+		found.clear();
+		scanBorder(grid, cluster.top, cluster.left, 1, 0, cluster.rows, 0, -1, found);
+		for (unsigned int i = 0; i < found.size(); i++)
+		{
+			e.node = grid->getNode(cluster.top + found[i], cluster.left)->getID();
+			e.across = grid->getNode(cluster.top + found[i], cluster.left - 1)->getID();
+			cluster.entrances.push_back(e);
+		}
+	}
+	if (right < grid->getNumCols() - 1)	// east
+	{
+		found.clear();
+		scanBorder(grid, cluster.top, right, 1, 0, cluster.rows, 0, 1, found);
+		for (unsigned int i = 0; i < found.size(); i++)
+		{
+			e.node = grid->getNode(cluster.top + found[i], right)->getID();
+			e.across = grid->getNode(cluster.top + found[i], right + 1)->getID();
+			cluster.entrances.push_back(e);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////
+// one sweep of the cluster from each entrance gives its cost to all the
+// others. The sweeps are local, so linking never needs more than one
+// cluster of scratch however big the grid is
+void
+PathHierarchy::linkCluster(Grid* grid, int k)
+{
+	Cluster& cluster = clusters[k];
+	int n = cluster.entrances.size();
+	int nCols = grid->getNumCols();
+	cluster.costs.assign(n * n, -1);
+	for (int i = 0; i < n; i++)
+	{
+		searchCluster(grid, k, cluster.entrances[i].node, -1, linking, true);
+		for (int j = 0; j < n; j++)
+		{
+			int node = cluster.entrances[j].node;
+			cluster.costs[i * n + j] = clusterCost(localSlot(k, node / nCols, node % nCols), linking);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////
+// a border only changes if a node on it did, and markDirty marks the
+// clusters on both sides of it, so the clean clusters keep their entrances
+void
+PathHierarchy::update(Grid* grid)
+{
+	if (!anyDirty) { return; }
+	for (unsigned int k = 0; k < clusters.size(); k++)
+		if (clusters[k].dirty)
+			findEntrances(grid, k);
+	for (unsigned int k = 0; k < clusters.size(); k++)
+		if (clusters[k].dirty)
+		{
+			linkCluster(grid, k);
+			clusters[k].dirty = false;
+		}
+	anyDirty = false;
+}
+
+////////////////////////////////////////////////////////////////
+// n's cluster needs new costs. If n is on the edge of it, the entrances
+// on that border can move, so the cluster across needs relinking too
+void
+PathHierarchy::markDirty(Grid* grid, GridNode* n)
+{
+	if (clusters.empty()) { return; }
+	int k = clusterOf(grid, n->getID());
+	int r = n->getRow() % CLUSTER_SIZE;
+	int c = n->getColumn() % CLUSTER_SIZE;
+	clusters[k].dirty = true;
+	if (r == 0 && k >= clusterCols) { clusters[k - clusterCols].dirty = true; }
+	if (r == CLUSTER_SIZE - 1 && k + clusterCols < (int)clusters.size()) { clusters[k + clusterCols].dirty = true; }
+	if (c == 0 && k % clusterCols > 0) { clusters[k - 1].dirty = true; }
+	if (c == CLUSTER_SIZE - 1 && k % clusterCols < clusterCols - 1) { clusters[k + 1].dirty = true; }
+	anyDirty = true;
+}
+
+////////////////////////////////////////////////////////////////
+// Dijkstra from node from, with the same moves and costs as Grid::aStar,
+// never leaving cluster k. With a node to head for it is A* instead, stops
+// when it gets there and returns its cost, -1 if it can't be reached (or
+// to is -1 and the whole cluster was swept).
+// Parents are left in the context for the caller to walk back along.
+// The records are by node ID, or with local by localSlot, which only
+// needs CLUSTER_SIZE squared of them (parents are slots then too)
+int
+PathHierarchy::searchCluster(Grid* grid, int k, int from, int to, SearchContext& context, bool local)
+{
+	Cluster& cluster = clusters[k];
+	std::vector<SearchNode>& searchData = context.searchData;
+	OpenList& openList = context.openList;
+	int nCols = grid->getNumCols();
+	int goal = to;	// node ID, for the estimate
+	int onOpenList, onClosedList;
+	context.newSearch(onOpenList, onClosedList);
+	if (local)
+	{
+		from = localSlot(k, from / nCols, from % nCols);
+		if (to != -1) { to = localSlot(k, to / nCols, to % nCols); }
+	}
+
+	SearchNode& first = searchData[from];
+	first.whichList = onOpenList;
+	first.gCost = 0;
+	first.parent = -1;
+	openList.push(from, 0);
+	while (!openList.empty())
+	{
+		int current = openList.pop();
+		searchData[current].whichList = onClosedList;
+		if (current == to) { return searchData[current].gCost; }
+
+		GridNode* current_node = local ? grid->getNode(cluster.top + current / CLUSTER_SIZE, cluster.left + current % CLUSTER_SIZE) : grid->getNodeByID(current);
+		GridNode* neighbors[8];	// {North,South,East,West,NE,NW,SE,SW}, same order as getAllNeighbors
+		grid->getNeighbors(current_node, neighbors);
+		for (int i = 0; i < 8; i++)
+		{
+			if (neighbors[i] == NULL) { continue; }
+			int r = neighbors[i]->getRow() - cluster.top;
+			int c = neighbors[i]->getColumn() - cluster.left;
+			if (r < 0 || c < 0 || r >= cluster.rows || c >= cluster.cols) { continue; }	// outside the cluster
+
+			int id = local ? r * CLUSTER_SIZE + c : neighbors[i]->getID();
+			SearchNode& neighbor = searchData[id];
+			if (neighbor.whichList == onClosedList) { continue; }
+			int new_gCost = searchData[current].gCost + (i < 4 ? (int)NODESIZE : diagonal_cost);
+			if (neighbor.whichList != onOpenList)
+			{
+				neighbor.whichList = onOpenList;
+				neighbor.gCost = new_gCost;
+				neighbor.parent = current;
+				neighbor.fCost = new_gCost + (to == -1 ? 0 : estimate(grid, neighbors[i]->getID(), goal));
+				openList.push(id, neighbor.fCost);
+			}
+			else if (new_gCost < neighbor.gCost)
+			{
+				neighbor.fCost += new_gCost - neighbor.gCost;	// same estimate as before
+				neighbor.gCost = new_gCost;
+				neighbor.parent = current;
+				openList.decreaseKey(id, neighbor.fCost);
+			}
+		}
+	}
+	return -1;
+}
+
+int
+PathHierarchy::localSlot(int k, int row, int col)
+{
+	return (row - clusters[k].top) * CLUSTER_SIZE + col - clusters[k].left;
+}
+
+int
+PathHierarchy::clusterCost(int slot, SearchContext& context)
+{
+	if (context.searchData[slot].whichList != context.listMarker) { return -1; }
+	return context.searchData[slot].gCost;
+}
+
+////////////////////////////////////////////////////////////////
+// abstract search: reach to from from for cost, h is to's estimate to the goal
+void
+PathHierarchy::addEdge(int from, int to, int cost, int h, SearchContext& context)
+{
+	SearchNode& next = context.searchData[to];
+	int new_gCost = context.searchData[from].gCost + cost;
+	if (next.whichList == context.listMarker) { return; }	// closed
+	if (next.whichList != context.listMarker - 1)
+	{
+		next.whichList = context.listMarker - 1;
+		next.gCost = new_gCost;
+		next.parent = from;
+		next.fCost = new_gCost + h;
+		context.openList.push(to, next.fCost);
+	}
+	else if (new_gCost < next.gCost)
+	{
+		next.gCost = new_gCost;
+		next.parent = from;
+		next.fCost = new_gCost + h;
+		context.openList.decreaseKey(to, next.fCost);
+	}
+}
+
+////////////////////////////////////////////////////////////////
+// sweep the start's and the goal's clusters to hook them up to the
+// entrances, A* over the entrances, then fill in the nodes inside
+// each cluster the abstract path goes through
+std::deque<GridNode*>
+PathHierarchy::findPath(Grid* grid, GridNode* start, GridNode* end, SearchContext& context)
+{
+	std::deque<GridNode*> path;
+	if (start == NULL || end == NULL || !end->isClear() || start == end) { return path; }
+	context.fit(grid->getNumRows() * grid->getNumCols());
+	std::vector<SearchNode>& searchData = context.searchData;
+	std::vector<int>& startCost = context.startCost;
+	std::vector<int>& goalCost = context.goalCost;
+
+	int s = start->getID();
+	int g = end->getID();
+	int startCluster = clusterOf(grid, s);
+	int goalCluster = clusterOf(grid, g);
+
+	std::vector<Entrance>& goalEntrances = clusters[goalCluster].entrances;
+	searchCluster(grid, goalCluster, g, -1, context);	// moves cost the same both ways, so this is the cost to the goal
+	goalCost.resize(goalEntrances.size());
+	for (unsigned int i = 0; i < goalEntrances.size(); i++)
+		goalCost[i] = clusterCost(goalEntrances[i].node, context);
+
+	std::vector<Entrance>& startEntrances = clusters[startCluster].entrances;
+	searchCluster(grid, startCluster, s, -1, context);
+	startCost.resize(startEntrances.size());
+	for (unsigned int i = 0; i < startEntrances.size(); i++)
+		startCost[i] = clusterCost(startEntrances[i].node, context);
+	int direct = startCluster == goalCluster ? clusterCost(g, context) : -1;	// without leaving the cluster
+
+	int onOpenList, onClosedList;
+	context.newSearch(onOpenList, onClosedList);
+	SearchNode& first = searchData[s];
+	first.whichList = onOpenList;
+	first.gCost = 0;
+	first.parent = -1;
+	context.openList.push(s, 0);
+
+	bool found = false;
+	while (!context.openList.empty())
+	{
+		int current = context.openList.pop();
+		searchData[current].whichList = onClosedList;
+		if (current == g) { found = true; break; }
+
+		if (current == s)
+		{
+			for (unsigned int j = 0; j < startEntrances.size(); j++)
+				if (startCost[j] >= 0)
+					addEdge(s, startEntrances[j].node, startCost[j], estimate(grid, startEntrances[j].node, g), context);
+			if (direct >= 0)
+				addEdge(s, g, direct, 0, context);
+		}
+
+		int k = clusterOf(grid, current);
+		std::vector<Entrance>& entrances = clusters[k].entrances;
+		int n = entrances.size();
+		for (int i = 0; i < n; i++)
+		{
+			if (entrances[i].node != current) { continue; }	// a corner node can be an entrance on two sides
+			addEdge(current, entrances[i].across, (int)NODESIZE, estimate(grid, entrances[i].across, g), context);
+			if (current == s) { continue; }	// the sweep from the start already covered the rest
+			for (int j = 0; j < n; j++)
+				if (j != i && clusters[k].costs[i * n + j] >= 0)
+					addEdge(current, entrances[j].node, clusters[k].costs[i * n + j], estimate(grid, entrances[j].node, g), context);
+			if (k == goalCluster && goalCost[i] >= 0)
+				addEdge(current, g, goalCost[i], 0, context);
+		}
+	}
+	if (!found) { return path; }
+
+	std::vector<int> waypoints;	// the abstract path, goal first
+	for (int current = g; current != -1; current = searchData[current].parent)
+		waypoints.push_back(current);
+
+	// fill in between each pair of waypoints, crossing a border is a single step
+	for (int i = waypoints.size() - 1; i > 0; i--)
+	{
+		int from = waypoints[i];
+		int to = waypoints[i - 1];
+		int k = clusterOf(grid, from);
+		if (k != clusterOf(grid, to))
+		{
+			path.push_back(grid->getNodeByID(to));
+			continue;
+		}
+		searchCluster(grid, k, from, to, context);
+		std::deque<GridNode*>::iterator insertAt = path.end();
+		for (int current = to; current != from; current = searchData[current].parent)
+			insertAt = path.insert(insertAt, grid->getNodeByID(current));
+	}
+	return path;
+}
+
+int
+PathHierarchy::getNumEntrances()
+{
+	int count = 0;
+	for (unsigned int k = 0; k < clusters.size(); k++)
+		count += clusters[k].entrances.size();
+	return count;
+}
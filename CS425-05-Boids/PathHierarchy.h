@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////
+// Hierarchical pathfinding (HPA*) over a Grid
+// The grid is cut into square clusters. Wherever two clusters touch
+// along an open stretch of border there is an entrance, and the cost
+// of getting between any two entrances of a cluster is found once, at
+// load. A search then runs over the entrances only and fills in the
+// nodes of just the stretches it ends up using, so long paths on big
+// levels only look at a few nodes per cluster crossed.
+// Paths are close to optimal, not always optimal.
+// Searches only read the hierarchy (their scratch is the caller's
+// SearchContext), so relinking after the grid changes is done up front,
+// by update(), not in the middle of a search.
+
+#pragma once
+#include <vector>
+#include <deque>
+#include "Grid.h"
+#include "SearchContext.h"
+
+#define CLUSTER_SIZE 10		// nodes along each side of a cluster
+#define ENTRANCE_SPLIT 6	// open border stretches at least this long get an entrance at each end, shorter ones one in the middle
+
+class PathHierarchy
+{
+private:
+	struct Entrance {
+		int node;				// node ID of the entrance, inside its cluster
+		int across;				// node ID on the other side of the border it steps to
+	};
+	struct Cluster {
+		int top, left;			// first row and column of the cluster
+		int rows, cols;			// size, the clusters on the far edges can be smaller
+		std::vector<Entrance> entrances;
+		std::vector<int> costs;	// between each pair of entrances inside the cluster, entrances.size() squared (-1 = no way)
+		bool dirty;				// walkability changed in or next to it since it was linked
+	};
+	int clusterRows;				// number of clusters down
+	int clusterCols;				// number of clusters across
+	std::vector<Cluster> clusters;	// by cluster row * clusterCols + cluster column
+	bool anyDirty;					// some cluster needs linking again
+
+	SearchContext linking;			// scratch for the sweeps that link the clusters, one cluster's worth (see searchCluster)
+
+	int clusterOf(Grid* grid, int node);	// cluster the node is in
+	void findEntrances(Grid* grid, int k);	// entrances on every border of cluster k
+	void linkCluster(Grid* grid, int k);	// costs between the entrances of cluster k
+	int searchCluster(Grid* grid, int k, int from, int to, SearchContext& context, bool local = false);	// Dijkstra from node from, staying in cluster k, stopping at to (-1: sweep it all)
+	int localSlot(int k, int row, int col);		// where (row,col) of cluster k is kept in a local searchCluster
+	int clusterCost(int slot, SearchContext& context);	// cost to slot (node ID, or localSlot) in the last searchCluster (-1 = not reached)
+	void addEdge(int from, int to, int cost, int h, SearchContext& context);	// abstract search: relax one edge
+
+public:
+	PathHierarchy();
+	~PathHierarchy();
+
+	void build(Grid* grid);						// cluster the grid and link every entrance
+	void bake(Grid* grid, std::vector<int>& out);	// the linked clusters as ints, for a compiled level (LevelFile)
+	bool load(Grid* grid, const int* baked, int count);	// instead of build: a bake of the same walls (false if it doesn't fit this grid)
+	void markDirty(Grid* grid, GridNode* n);	// n was cleared or blocked, what it touches needs relinking
+	void update(Grid* grid);					// find entrances and costs again for the dirty clusters
+	bool isDirty() { return anyDirty; }			// needs an update() before the next search
+	std::deque<GridNode*> findPath(Grid* grid, GridNode* start, GridNode* end, SearchContext& context);	// path from start to end, start left off, end included (up to date hierarchy only)
+	int getNumClusters() { return (int)clusters.size(); }
+	int getNumEntrances();						// abstract nodes over all the clusters
+};
@@ -0,0 +1,292 @@
+#include "PathService.h"
+#include "Agent.h"
+#include "Grid.h"
+#include "SlicedSearch.h"
+#include "SearchContext.h"
+#include <algorithm>
+#include <chrono>
+
+////////////////////////////////////////////////////////////////
+// start the workers, or none to search time sliced on the main thread
+PathService::PathService(int numThreads)
+{
+	if (numThreads < 0)
+		numThreads = 0;
+	nextTicket = 1;
+	quit = false;
+	paused = false;
+	slice = numThreads == 0 ? new SlicedSearch() : NULL;
+	sliceRequest.ticket = 0;
+	frameExpansions = PATH_FRAME_EXPANSIONS;
+	frameMicroseconds = PATH_FRAME_MICROSECONDS;
+	searchLimit = PATH_SEARCH_LIMIT;
+	searching.assign(numThreads, 0);
+	for (int i = 0; i < numThreads; i++)
+		contexts.push_back(new SearchContext());
+	for (int i = 0; i < numThreads; i++)
+		workers.push_back(std::thread(&PathService::workerLoop, this, i));
+}
+
+////////////////////////////////////////////////////////////////
+// stop and join the workers. Anything not delivered yet is dropped
+PathService::~PathService()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		pending.clear();
+		quit = true;
+	}
+	wake.notify_all();
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers[i].join();
+	for (unsigned int i = 0; i < contexts.size(); i++)
+		delete contexts[i];
+	if (slice != NULL)
+		delete slice;
+}
+
+////////////////////////////////////////////////////////////////
+// std::push_heap keeps the request that comes after nothing on top:
+// the highest priority, and the oldest ticket among those
+bool
+PathService::comesAfter(const Request& a, const Request& b)
+{
+	if (a.priority != b.priority) { return a.priority < b.priority; }
+	return a.ticket > b.ticket;
+}
+
+bool
+PathService::isIdle()
+{
+	if (!pending.empty() || sliceRequest.ticket != 0) { return false; }
+	for (unsigned int i = 0; i < searching.size(); i++)
+		if (searching[i] != 0) { return false; }
+	return true;
+}
+
+void
+PathService::workerLoop(int worker)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while (true)
+	{
+		wake.wait(guard, [this] { return quit || (!paused && !pending.empty()); });
+		if (quit) { return; }
+
+		std::pop_heap(pending.begin(), pending.end(), comesAfter);
+		Request r = pending.back();
+		pending.pop_back();
+		searching[worker] = r.ticket;
+		guard.unlock();
+
+		Result result;
+		result.ticket = r.ticket;
+		result.agent = r.agent;
+		result.path = r.grid->findPath(r.start, r.goal, (SearchMode)r.mode, *contexts[worker]);
+
+		guard.lock();
+		searching[worker] = 0;
+		if (cancelled.erase(r.ticket) == 0)
+			finished.push_back(result);
+		idle.notify_all();
+	}
+}
+
+////////////////////////////////////////////////////////////////
+// queue a search from start to goal for agent. Returns straight away with
+// the ticket the result will be delivered under
+int
+PathService::request(Agent* agent, Grid* grid, GridNode* start, GridNode* goal, int priority)
+{
+	Request r;
+	r.priority = priority;
+	r.agent = agent;
+	r.grid = grid;
+	r.mode = grid->getSearchMode();
+	r.start = start;
+	r.goal = goal;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		r.ticket = nextTicket++;
+		if (nextTicket <= 0) { nextTicket = 1; }	// wrapped, 0 means no ticket
+		pending.push_back(r);
+		std::push_heap(pending.begin(), pending.end(), comesAfter);
+	}
+	wake.notify_one();
+	return r.ticket;
+}
+
+////////////////////////////////////////////////////////////////
+// the request is wherever it has got to: still queued, being searched,
+// or found and waiting to be delivered. Unknown tickets (0, delivered,
+// cancelled already) are ignored
+void
+PathService::cancel(int ticket)
+{
+	if (ticket == 0) { return; }
+	std::lock_guard<std::mutex> guard(lock);
+	if (sliceRequest.ticket == ticket)
+	{
+		sliceRequest.ticket = 0;	//runSlices moves on to the next one
+		return;
+	}
+	for (unsigned int i = 0; i < pending.size(); i++)
+		if (pending[i].ticket == ticket)
+		{
+			pending.erase(pending.begin() + i);
+			std::make_heap(pending.begin(), pending.end(), comesAfter);
+			return;
+		}
+	for (unsigned int i = 0; i < searching.size(); i++)
+		if (searching[i] == ticket)
+		{
+			cancelled.insert(ticket);	//the worker drops it when it's done
+			return;
+		}
+	for (unsigned int i = 0; i < finished.size(); i++)
+		if (finished[i].ticket == ticket)
+		{
+			finished.erase(finished.begin() + i);
+			return;
+		}
+}
+
+void
+PathService::cancelAll()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	pending.clear();
+	finished.clear();
+	sliceRequest.ticket = 0;
+	for (unsigned int i = 0; i < searching.size(); i++)
+		if (searching[i] != 0)
+			cancelled.insert(searching[i]);
+}
+
+void
+PathService::wait()
+{
+	if (workers.empty())	//nobody else is going to do it
+		runSlices(0, 0);
+	std::unique_lock<std::mutex> guard(lock);
+	idle.wait(guard, [this] { return isIdle(); });
+}
+
+////////////////////////////////////////////////////////////////
+// requests keep coming in while paused, they wait on the queue. The
+// searches already going are let finish, on the grid as it was
+void
+PathService::pause()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	paused = true;
+	idle.wait(guard, [this] {
+		for (unsigned int i = 0; i < searching.size(); i++)
+			if (searching[i] != 0) { return false; }
+		return true;
+	});
+}
+
+void
+PathService::resume()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		paused = false;
+	}
+	wake.notify_all();
+}
+
+////////////////////////////////////////////////////////////////
+// hand the finished paths over. Agents take them on the main thread
+// (they touch the walk list and the scene), and an agent that has been
+// given somewhere else to go since just ignores the old path
+int
+PathService::deliver()
+{
+	if (workers.empty())
+		runSlices(frameExpansions, frameMicroseconds);
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (finished.empty()) { return 0; }
+		delivering.swap(finished);
+	}
+	int count = delivering.size();
+	for (unsigned int i = 0; i < delivering.size(); i++)
+		delivering[i].agent->receivePath(delivering[i].ticket, delivering[i].path);
+	delivering.clear();
+	return count;
+}
+
+////////////////////////////////////////////////////////////////
+// time sliced: carry on with the current search, then start on the next
+// request, and so on, until the budget is spent or there is nothing left.
+// A search is finished when it finds the goal, finds it can't, or hits the
+// search limit; the last two deliver the path to the closest node reached
+void
+PathService::runSlices(int maxExpansions, int maxMicroseconds)
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point began = Clock::now();
+	int expansionsLeft = maxExpansions;
+	std::unique_lock<std::mutex> guard(lock);
+	while (true)
+	{
+		if (sliceRequest.ticket == 0)	// nothing on the go, start the next one
+		{
+			if (pending.empty()) { return; }
+			std::pop_heap(pending.begin(), pending.end(), comesAfter);
+			sliceRequest = pending.back();
+			pending.pop_back();
+			slice->begin(sliceRequest.grid, sliceRequest.start, sliceRequest.goal);
+		}
+
+		int timeLeft = 0;	// microseconds, 0 = no limit
+		if (maxMicroseconds > 0)
+		{
+			timeLeft = maxMicroseconds - (int)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - began).count();
+			if (timeLeft <= 0) { return; }
+		}
+		int allowed = expansionsLeft;
+		if (searchLimit > 0 && (allowed <= 0 || searchLimit - slice->getExpansions() < allowed))
+			allowed = searchLimit - slice->getExpansions();
+
+		int before = slice->getExpansions();
+		SliceStatus status = slice->resume(allowed, timeLeft);
+		if (maxExpansions > 0) { expansionsLeft -= slice->getExpansions() - before; }
+
+		bool limitHit = searchLimit > 0 && slice->getExpansions() >= searchLimit;
+		if (status != SLICE_RUNNING || limitHit)
+		{
+			Result result;
+			result.ticket = sliceRequest.ticket;
+			result.agent = sliceRequest.agent;
+			result.path = status == SLICE_FOUND ? slice->getPath() : slice->getPartialPath();
+			finished.push_back(result);
+			sliceRequest.ticket = 0;
+		}
+		if (maxExpansions > 0 && expansionsLeft <= 0) { return; }
+	}
+}
+
+void
+PathService::setFrameBudget(int expansions, int microseconds)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	frameExpansions = std::max(expansions, 0);
+	frameMicroseconds = std::max(microseconds, 0);
+}
+
+void
+PathService::setSearchLimit(int expansions)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	searchLimit = std::max(expansions, 0);
+}
+
+int
+PathService::getNumPending()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return pending.size();
+}
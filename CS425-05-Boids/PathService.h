@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////
+// Pathfinding off the main thread
+// Agents ask for a path and get a ticket back straight away. Worker
+// threads take the requests highest priority first (oldest first among
+// equals) and run Grid::findPath; deliver(), called on the main thread
+// once per step, hands the finished paths to their agents.
+// A request can be cancelled any time before it is delivered, and an
+// agent ignores any path that isn't for the last ticket it was given.
+// Each worker searches with its own SearchContext, so they all search at
+// once; the grid must not change meanwhile, pause() them around changes.
+// With no worker threads the searches run on the main thread instead,
+// time sliced: each deliver() carries on with them for at most a frame
+// budget of expansions and microseconds, and a search that goes past the
+// search limit is cut short and delivers the path as far as it got
+// towards the goal (an unreachable goal otherwise sweeps the level). A
+// search the grid changes under between frames starts over.
+
+#pragma once
+#include <vector>
+#include <deque>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define PATH_THREADS 2		// default number of worker threads
+#define PATH_PRIORITY 0		// default request priority, higher goes first
+#define PATH_FRAME_EXPANSIONS 4000	// time sliced: most nodes expanded per deliver()
+#define PATH_FRAME_MICROSECONDS 1000	// time sliced: most time searching per deliver()
+#define PATH_SEARCH_LIMIT 50000		// time sliced: expansions before a search settles for the closest it got (0 = never)
+
+// forward declarations ----------------
+class Agent;
+class Grid;
+class GridNode;
+class SlicedSearch;
+class SearchContext;
+//--------------------------------------
+
+class PathService
+{
+private:
+	struct Request {
+		int ticket;			// handed back to the agent, 0 is never used
+		int priority;		// higher goes first
+		Agent* agent;		// who gets the path
+		Grid* grid;			// grid to search
+		int mode;			// SearchMode, the grid's when asked for (the main thread can change it meanwhile)
+		GridNode* start;
+		GridNode* goal;
+	};
+	struct Result {
+		int ticket;
+		Agent* agent;
+		std::deque<GridNode*> path;
+	};
+
+	std::vector<Request> pending;			// heap, see comesAfter()
+	std::vector<int> searching;				// ticket each worker is searching for (0 = none)
+	std::unordered_set<int> cancelled;		// tickets being searched that nobody wants any more
+	std::vector<Result> finished;			// found, waiting for deliver()
+	std::vector<Result> delivering;			// swapped with finished by deliver(), so the lock isn't held while agents take their paths
+	std::vector<std::thread> workers;
+	std::vector<SearchContext*> contexts;	// scratch space, one per worker
+	std::mutex lock;						// guards everything above but delivering, and nextTicket and quit
+	std::condition_variable wake;			// signalled when requests come in or on shutdown
+	std::condition_variable idle;			// signalled when a worker finishes a request
+	int nextTicket;
+	bool quit;
+	bool paused;							// workers don't start new searches
+
+	SlicedSearch* slice;		// time sliced: the search being carried on, main thread only
+	Request sliceRequest;		// what it is for (ticket 0 = none)
+	int frameExpansions;		// budget for each deliver()
+	int frameMicroseconds;
+	int searchLimit;
+
+	static bool comesAfter(const Request& a, const Request& b);	// heap ordering
+	bool isIdle();							// nothing pending or being searched, call with the lock held
+	void workerLoop(int worker);
+	void runSlices(int maxExpansions, int maxMicroseconds);	// time sliced: search on the main thread until the budget is spent (0 = no limit)
+
+public:
+	PathService(int numThreads = PATH_THREADS);	// 0: time sliced on the main thread
+	~PathService();		// drops whatever is pending and waits for the searches in progress
+
+	int request(Agent* agent, Grid* grid, GridNode* start, GridNode* goal, int priority = PATH_PRIORITY);	// queue a search, returns its ticket
+	void cancel(int ticket);	// forget a request, it won't be searched or delivered (if it is being searched, the result is dropped)
+	void cancelAll();			// forget every request
+	void wait();				// block until nothing is pending or being searched (time sliced: finish every search now)
+	void pause();				// main thread: block until no worker is searching, and start no more until resume(), so the grids can be changed
+	void resume();
+	int deliver();				// main thread: hand every finished path to its agent, returns how many (time sliced: search for a while first)
+	void setFrameBudget(int expansions, int microseconds);	// time sliced: searching each deliver() may do (0 = no limit on that)
+	void setSearchLimit(int expansions);	// time sliced: when to settle for a partial path (0 = never)
+	int getNumPending();		// requests not searched yet
+	int getNumThreads() { return workers.size(); }	// 0: time sliced
+};
@@ -0,0 +1,30 @@
+#include "SearchContext.h"
+
+SearchContext::SearchContext()
+{
+	listMarker = 0;
+}
+
+SearchContext::~SearchContext()
+{}
+
+////////////////////////////////////////////////////////////////
+// list markers only ever go up, so the records left over from another
+// grid of the same size can't be mistaken for this search's
+void
+SearchContext::fit(int numNodes)
+{
+	if ((int)searchData.size() == numNodes) { return; }
+	searchData.assign(numNodes, SearchNode());
+	openList.resize(numNodes);
+	listMarker = 0;
+}
+
+void
+SearchContext::newSearch(int& onOpenList, int& onClosedList)
+{
+	listMarker += 2;
+	onOpenList = listMarker - 1;
+	onClosedList = listMarker;
+	openList.clear();	//anything left over from the last search is obsolete too
+}
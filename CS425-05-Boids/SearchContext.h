@@ -0,0 +1,28 @@
+////////////////////////////////////////////////////////
+// Scratch space for one search at a time
+// Everything a search writes while it runs (costs, parents, list
+// markers, the open list) lives here, none of it in the Grid, so the grid
+// is only read during a search. Any number of searches can run on one
+// grid at once as long as each has its own context and nobody changes
+// the grid meanwhile: the path service gives each worker one, the grid
+// keeps one for the main thread.
+
+#pragma once
+#include <vector>
+#include "Grid.h"
+#include "GridSearch.h"
+
+class SearchContext {  // helper class: all the per search state of aStar, JPS and HPA*
+public:
+	std::vector<SearchNode> searchData;	// JPS and HPA* costs, list markers and parents, by node ID
+	OpenList openList;					// open nodes ordered by F cost
+	int listMarker;						// closed list value of the current search, open is one less
+	std::vector<int> startCost;			// HPA*: cost from the start to each entrance of its cluster (-1 = no way)
+	std::vector<int> goalCost;			// HPA*: cost from each entrance of the goal's cluster to the goal (-1 = no way)
+	ClassicSearch classic;				// aStar, keeps its own records
+
+	SearchContext();
+	~SearchContext();
+	void fit(int numNodes);				// make room for a grid of numNodes nodes (nothing to do if there is)
+	void newSearch(int& onOpenList, int& onClosedList);	// markers for a new search, so old ones are obsolete
+};
@@ -0,0 +1,160 @@
+#include "SearchTrace.h"
+
+#ifdef SEARCH_TRACE
+#include "Grid.h"
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+
+////////////////////////////////////////////////////////////////
+// start the writer. The file is started over each run. The ring holds at
+// least four walls records, so one always fits with searches behind it
+SearchTrace::SearchTrace(const std::string& fileName, int numRows, int numCols)
+{
+	unsigned long long wallBytes = 8 * sizeof(int) + (unsigned long long)numRows * ((numCols + 63) / 64) * sizeof(BitWord);
+	unsigned long long size = TRACE_BUFFER_SIZE;
+	while (size < 4 * wallBytes)
+		size *= 2;
+	ring.resize(size);
+	ringMask = size - 1;
+	head = 0;
+	tail = 0;
+	dropped = 0;
+	tooBig = 0;
+	gridRevision = -1;
+	quit = false;
+	file.open(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		std::cout << "ERROR, TRACE FILE COULD NOT BE OPENED" << std::endl;
+	writer = std::thread(&SearchTrace::writerLoop, this);
+}
+
+SearchTrace::~SearchTrace()
+{
+	{
+		std::lock_guard<std::mutex> guard(wakeLock);
+		quit = true;
+	}
+	wake.notify_all();
+	writer.join();	//its last drain() wrote out the rest
+	if (dropped > 0)
+		std::cout << "Search trace: " << dropped << " records dropped, the writer fell behind" << std::endl;
+	if (tooBig > 0)
+		std::cout << "Search trace: " << tooBig << " records dropped, bigger than the " << ring.size() << " byte buffer" << std::endl;
+}
+
+////////////////////////////////////////////////////////////////
+// a record only becomes visible to the writer when head moves past its
+// end, so the writer never sees half of one. One that could never fit
+// says so the first time
+bool
+SearchTrace::push()
+{
+	unsigned long long size = record.size() * sizeof(int);
+	if (size > ring.size())
+	{
+		if (tooBig++ == 0)
+			std::cout << "Search trace: a " << size << " byte record can't fit the " << ring.size() << " byte buffer, dropped" << std::endl;
+		return false;
+	}
+	unsigned long long at = head.load(std::memory_order_relaxed);
+	if (size > ring.size() - (at - tail.load(std::memory_order_acquire)))
+	{
+		dropped++;
+		return false;
+	}
+	const char* bytes = (const char*)&record[0];
+	unsigned long long offset = at & ringMask;
+	unsigned long long first = std::min(size, ring.size() - offset);	// up to the end of the ring, the rest wraps round
+	memcpy(&ring[offset], bytes, first);
+	memcpy(&ring[0], bytes + first, size - first);
+	head.store(at + size, std::memory_order_release);
+	return true;
+}
+
+void
+SearchTrace::drain()
+{
+	unsigned long long from = tail.load(std::memory_order_relaxed);
+	unsigned long long to = head.load(std::memory_order_acquire);
+	if (from == to) { return; }
+	unsigned long long offset = from & ringMask;
+	unsigned long long first = std::min(to - from, ring.size() - offset);
+	file.write(&ring[offset], first);
+	file.write(&ring[0], to - from - first);
+	file.flush();
+	tail.store(to, std::memory_order_release);
+}
+
+void
+SearchTrace::writerLoop()
+{
+	std::unique_lock<std::mutex> guard(wakeLock);
+	while (!quit)
+	{
+		wake.wait_for(guard, std::chrono::milliseconds(TRACE_FLUSH_MS));
+		guard.unlock();
+		drain();
+		guard.lock();
+	}
+	guard.unlock();
+	drain();
+}
+
+////////////////////////////////////////////////////////////////
+// the walls only go in when they have changed since the last record,
+// searches between changes just say which revision they were on. The
+// walls are the grid's walkable bits as they are, a word per 64 nodes.
+// If they don't fit (the writer is behind) the search is dropped too (it
+// would be drawn on the old ones), and the next search tries them again
+void
+SearchTrace::endSearch(Grid* grid, GridNode* start, GridNode* goal, const std::deque<GridNode*>& path)
+{
+	if (gridRevision != grid->getRevision())
+	{
+		gridRevision = grid->getRevision();
+		std::string name = grid->getName();
+		const Bitboard& walls = grid->getWalkBits();
+		int numWords = walls.getNumRows() * walls.getRowWords();
+		record.assign(8 + numWords * sizeof(BitWord) / sizeof(int), 0);
+		record[0] = TRACE_GRID;
+		record[2] = grid->getNumRows();
+		record[3] = grid->getNumCols();
+		record[4] = gridRevision;
+		record[5] = walls.getRowWords();
+		record[6] = name.size();
+		if (numWords > 0)
+			memcpy(&record[8], walls.row(0), numWords * sizeof(BitWord));
+		int nameAt = record.size();
+		record.resize(record.size() + (name.size() + sizeof(int) - 1) / sizeof(int), 0);
+		if (!name.empty())
+			memcpy(&record[nameAt], name.c_str(), name.size());
+		record[1] = record.size() * sizeof(int);
+		if (!push())
+		{
+			gridRevision = -1;
+			closed.clear();
+			open.clear();
+			return;
+		}
+	}
+
+	record.assign(9, 0);
+	record[0] = TRACE_SEARCH;
+	record[2] = gridRevision;
+	record[3] = start->getID();
+	record[4] = goal->getID();
+	record[5] = !path.empty() || start == goal;
+	record[6] = closed.size();
+	record[7] = open.size();
+	record[8] = path.size();
+	record.insert(record.end(), closed.begin(), closed.end());
+	record.insert(record.end(), open.begin(), open.end());
+	for (unsigned int i = 0; i < path.size(); i++)
+		record.push_back(path[i]->getID());
+	record[1] = record.size() * sizeof(int);
+	push();
+	closed.clear();
+	open.clear();
+}
+#endif
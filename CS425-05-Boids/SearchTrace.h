@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////
+// Debug grids of aStar, off the main thread
+// Instead of writing a whole ASCII grid per search, aStar hands a small
+// binary record (which nodes were closed, which were open, the path) to
+// a ring buffer and goes on. A writer thread empties the buffer into
+// <level>Trace.bin every so often; TraceRender.cpp turns that file back
+// into the numbered <level>NGrid.txt files printToFile used to write.
+// The buffer has one writer and one reader, so it needs no lock: the
+// search thread only moves head, the writer thread only moves tail. A
+// record that doesn't fit is dropped and counted, the search never waits.
+// The walls go in as a bit per node (Bitboard rows) and the buffer is
+// sized from the grid so they always fit; a search record bigger than
+// the whole buffer can never go in, and is reported rather than counted
+// with the ones the writer fell behind on.
+// Only debug builds trace (SEARCH_TRACE), release builds leave it all out.
+
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+
+#ifndef NDEBUG
+#define SEARCH_TRACE
+#endif
+
+#define TRACE_BUFFER_SIZE (1 << 22)	// least bytes of records waiting for the writer, a power of two (more on big grids)
+#define TRACE_FLUSH_MS 50			// how often the writer empties the buffer
+
+// the file is nothing but records, each a header and then ints -------
+enum TraceRecordType {
+	TRACE_GRID = 1,		// rows, cols, revision, rowWords, nameLength, 0, then the walkable nodes a bit each as rows of 64 bit words (Bitboard), the level name (padded to an int)
+	TRACE_SEARCH = 2	// revision, start, goal, found, numClosed, numOpen, numPath, then those node IDs
+};
+
+struct TraceHeader {
+	int type;			// TraceRecordType
+	int size;			// bytes in the whole record, header included
+};
+
+#ifdef SEARCH_TRACE
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <fstream>
+
+class Grid;
+class GridNode;
+
+class SearchTrace
+{
+private:
+	std::vector<char> ring;				// a power of two bytes, at least TRACE_BUFFER_SIZE
+	unsigned long long ringMask;		// its size - 1
+	std::atomic<unsigned long long> head;	// bytes ever pushed, moved by the search thread
+	std::atomic<unsigned long long> tail;	// bytes ever written out, moved by the writer
+	std::atomic<unsigned long> dropped;	// records that didn't fit
+	unsigned long tooBig;				// records bigger than the whole ring, search thread only
+	std::vector<int> record;			// scratch for the record being put together
+	std::vector<int> closed;			// nodes the search being recorded closed
+	std::vector<int> open;				// and left open
+	int gridRevision;					// revision of the last TRACE_GRID record (-1 = none yet)
+
+	std::ofstream file;
+	std::thread writer;
+	std::mutex wakeLock;
+	std::condition_variable wake;		// only ever waited on with a timeout, pushing never locks
+	bool quit;							// guarded by wakeLock
+
+	bool push();						// copy record into the ring, false if it was dropped
+	void drain();						// writer: write out everything pushed so far
+	void writerLoop();
+
+public:
+	SearchTrace(const std::string& fileName, int numRows, int numCols);	// the ring is sized for a grid that big
+	~SearchTrace();		// writes out whatever is left
+
+	// the search thread, after aStar: name the nodes it closed and left
+	// open, then endSearch with what it returned
+	void addClosed(int id) { closed.push_back(id); }
+	void addOpen(int id) { open.push_back(id); }
+	void endSearch(Grid* grid, GridNode* start, GridNode* goal, const std::deque<GridNode*>& path);
+	unsigned long getDropped() { return dropped + tooBig; }
+};
+#endif
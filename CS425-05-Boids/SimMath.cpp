@@ -0,0 +1,8 @@
+#include "SimMath.h"
+
+#ifdef HEADLESS
+const Vector3 Vector3::ZERO(0, 0, 0);
+const Vector3 Vector3::UNIT_X(1, 0, 0);
+const Vector3 Vector3::UNIT_Y(0, 1, 0);
+const Vector3 Vector3::UNIT_Z(0, 0, 1);
+#endif
@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////
+// Math types used by the simulation code (Grid, Agent, flocking)
+// In the game these are Ogre's own. The headless build (HEADLESS defined,
+// see CMakeLists.txt) has no Ogre, so it gets the small stand-in below,
+// which only has the parts of Ogre::Vector3 the simulation uses.
+
+#pragma once
+
+#ifdef HEADLESS
+#include <cmath>
+
+typedef float Real;
+
+class Vector3
+{
+public:
+	Real x, y, z;
+
+	Vector3() {};		// uninitialised, like Ogre's
+	Vector3(Real x, Real y, Real z) : x(x), y(y), z(z) {};
+
+	Real& operator[](int i) { return *(&x + i); }
+	Real operator[](int i) const { return *(&x + i); }
+
+	Vector3 operator+(const Vector3& v) const { return Vector3(x + v.x, y + v.y, z + v.z); }
+	Vector3 operator-(const Vector3& v) const { return Vector3(x - v.x, y - v.y, z - v.z); }
+	Vector3 operator-() const { return Vector3(-x, -y, -z); }
+	Vector3 operator*(Real s) const { return Vector3(x * s, y * s, z * s); }
+	Vector3 operator/(Real s) const { Real inv = 1.0f / s; return Vector3(x * inv, y * inv, z * inv); }
+	Vector3& operator+=(const Vector3& v) { x += v.x; y += v.y; z += v.z; return *this; }
+	Vector3& operator-=(const Vector3& v) { x -= v.x; y -= v.y; z -= v.z; return *this; }
+	Vector3& operator*=(Real s) { x *= s; y *= s; z *= s; return *this; }
+	bool operator==(const Vector3& v) const { return x == v.x && y == v.y && z == v.z; }
+	bool operator!=(const Vector3& v) const { return !(*this == v); }
+	friend Vector3 operator*(Real s, const Vector3& v) { return v * s; }
+
+	Real length() const { return std::sqrt(x * x + y * y + z * z); }
+	Real squaredLength() const { return x * x + y * y + z * z; }
+	Real dotProduct(const Vector3& v) const { return x * v.x + y * v.y + z * v.z; }
+
+	Real normalise()	// make unit length, returns the old length (zero vectors are left alone)
+	{
+		Real len = length();
+		if (len > Real(0.0))
+		{
+			Real inv = 1.0f / len;
+			x *= inv; y *= inv; z *= inv;
+		}
+		return len;
+	}
+	Vector3 normalisedCopy() const { Vector3 v = *this; v.normalise(); return v; }
+
+	static const Vector3 ZERO;
+	static const Vector3 UNIT_X;
+	static const Vector3 UNIT_Y;
+	static const Vector3 UNIT_Z;
+};
+
+#else
+#include <OgreVector3.h>
+
+typedef Ogre::Real Real;
+typedef Ogre::Vector3 Vector3;
+#endif
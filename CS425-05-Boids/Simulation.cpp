@@ -0,0 +1,416 @@
+#include "Simulation.h"
+#include "Agent.h"
+#include "Grid.h"
+#include "SpatialHash.h"
+#include "FlockKernel.h"
+#include "JobSystem.h"
+#include "PathService.h"
+#include "GridSearch.h"
+#include "SearchContext.h"
+#include "PathBatch.h"
+#include <cstdlib>
+#include <chrono>
+
+//-------------------------------------------------------------------------------------
+Simulation::Simulation(int numThreads)
+{
+	grid = NULL;
+	demoMode = false;
+	neighborRadius = NEIGHBORHOOD;
+	stepRate = STEP_RATE;
+	maxSteps = MAX_STEPS;
+	accumulator = 0;
+	interpolation = 1;
+	agentHash = new SpatialHash(neighborRadius);
+	jobs = new JobSystem(numThreads);
+	paths = new PathService();
+	batch = new PathBatch();
+	std::cout << "Agent update on " << jobs->getNumThreads() << " thread(s), flocking kernel: " << getFlockKernelName() << std::endl;	//also picks the kernel before any job asks for it
+}
+//-------------------------------------------------------------------------------------
+Simulation::~Simulation()
+{
+	delete paths;	//first, its workers may still be searching the grid for the agents
+	delete batch;
+	for (unsigned int i = 0; i < agentList.size(); i++)
+		delete agentList[i];
+	agentList.clear();
+	if (grid != NULL)
+		delete grid;
+	if (agentHash != NULL)
+		delete agentHash;
+	if (jobs != NULL)
+		delete jobs;
+}
+
+void
+Simulation::addAgent(Agent* a)
+{
+	agentList.push_back(a);
+}
+
+void
+Simulation::setGrid(Grid* g)
+{
+	if (grid != NULL && grid != g)
+	{
+		paths->cancelAll();	//nothing may still be searching the old grid
+		paths->wait();
+		delete grid;
+	}
+	grid = g;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//advance every agent by deltaTime.
+//the hash built here is also the read side of the update: move() reads
+//neighbors from this snapshot and writes only its own flock slot, so moves never race
+void
+Simulation::step(Real deltaTime)
+{
+	if (grid != NULL && grid->needsPreparing())	//changed since the last step, bring JPS+ and HPA* up to date
+	{
+		paths->pause();
+		grid->prepareSearches();
+		paths->resume();
+	}
+	paths->deliver();			//paths found since the last step, before anyone thinks
+	flock.savePositions();		//where everyone was, to draw from
+	agentHash->build(flock);	//bucket everyone once, flocking queries use it all step
+
+	// Lecture 5: Iterate over the list of agents
+	std::vector<Agent*>::iterator iter;
+	for (iter = agentList.begin(); iter != agentList.end(); iter++)
+		if (*iter != NULL)
+			(*iter)->think(deltaTime);	//arrivals touch other agents and Ogre, keep them serial
+
+	jobs->parallelFor(agentList.size(), AGENT_BATCH, [this, deltaTime](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			if (agentList[i] != NULL)
+				agentList[i]->move(deltaTime);
+	});
+
+	for (iter = agentList.begin(); iter != agentList.end(); iter++)
+		if (*iter != NULL)
+			(*iter)->apply();	//bring in the neighbors move() found before the next step looks again
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//bank frameTime and run every whole step that is now due.
+//a slow frame runs at most maxSteps steps and drops the rest, so a stall
+//can't snowball into ever longer frames. What is left over decides how far
+//between the last two steps syncNodes() draws everyone.
+int
+Simulation::advance(Real frameTime)
+{
+	Real stepTime = 1 / stepRate;
+	accumulator += frameTime;
+
+	int steps = 0;
+	while (accumulator >= stepTime && steps < maxSteps)
+	{
+		step(stepTime);
+		accumulator -= stepTime;
+		steps++;
+	}
+	if (accumulator >= stepTime) { accumulator = 0; }	//fell behind, catch up by skipping
+
+	interpolation = accumulator / stepTime;
+	return steps;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//the simulation only writes to the flock state, this pushes the results
+//out to the scene graph once per frame, on the main thread
+void
+Simulation::syncNodes()
+{
+	std::vector<Agent*>::iterator iter;
+	for (iter = agentList.begin(); iter != agentList.end(); iter++)
+		if (*iter != NULL)
+			(*iter)->syncNode(interpolation);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//send every agent to goal. One sweep of the grid builds the flow field,
+//then each agent just looks up its next node as it arrives, instead of
+//every agent running its own A* search
+void
+Simulation::followFlow(GridNode* goal)
+{
+	if (grid == NULL || goal == NULL || !goal->isClear()) { return; }
+	grid->flowTo(goal);	//build it now rather than on the first agent's arrival
+	std::vector<Agent*>::iterator iter;
+	for (iter = agentList.begin(); iter != agentList.end(); iter++)
+		if (*iter != NULL)
+			(*iter)->followFlow(goal);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//queue a search for a on the path service, returns the ticket to cancel it with
+int
+Simulation::requestPath(Agent* a, GridNode* start, GridNode* goal, int priority)
+{
+	return paths->request(a, grid, start, goal, priority);
+}
+
+void
+Simulation::cancelPath(int ticket)
+{
+	paths->cancel(ticket);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//the workers search the grid without any lock, so it can only change while
+//they are paused. The searches queued meanwhile see the change
+void
+Simulation::setWalkable(GridNode* n, bool walkable)
+{
+	if (n == NULL || n->isClear() == walkable) { return; }
+	paths->pause();
+	if (walkable) { n->setClear(); }
+	else { n->setOccupied(); }
+	paths->resume();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//the game's Left Ctrl: moveTo for every agent, so the searches go to the path
+//service like any other and this returns straight away. Each one looks in the
+//grid's path cache before it searches, so agents on the same node sent to the
+//same goal mostly share a search, and the paths come back through receivePath
+void
+Simulation::moveAgents(const std::vector<GridNode*>& goals, bool snap)
+{
+	for (unsigned int i = 0; i < agentList.size() && i < goals.size(); i++)
+		if (agentList[i] != NULL)
+			agentList[i]->moveTo(goals[i], PATH_PRIORITY, snap);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//swap the path service for one with numThreads workers. Whatever the old one
+//still has is finished and delivered first, so no agent is left waiting
+void
+Simulation::setPathThreads(int numThreads)
+{
+	paths->wait();
+	paths->deliver();
+	delete paths;
+	paths = new PathService(numThreads);
+}
+
+const std::vector<Agent*>&
+Simulation::getAgentList()
+{
+	return this->agentList;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//fill result with the flock slots within the neighborhood radius of pos
+void
+Simulation::getNeighbors(const Vector3& pos, std::vector<int>& result)
+{
+	agentHash->query(pos.x, pos.y, pos.z, neighborRadius, result);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//fill result with the flocking agents within the neighborhood radius of pos,
+//leaving out the agent in slot (the one asking)
+void
+Simulation::getFlockmates(int slot, const Vector3& pos, FlockNeighbors& result)
+{
+	agentHash->gatherFlockmates(slot, pos.x, pos.y, pos.z, neighborRadius, result);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//change the neighborhood radius, hash cells are kept the same size
+//so a query only has to look at the 3x3 cells around an agent
+void
+Simulation::setNeighborRadius(float radius)
+{
+	neighborRadius = radius;
+	agentHash->setCellSize(radius);
+}
+
+int
+Simulation::getNumThreads()
+{
+	return jobs->getNumThreads();
+}
+
+void
+Simulation::setStepRate(Real hz)
+{
+	if (hz <= 0) { return; }
+	stepRate = hz;
+	accumulator = 0;
+}
+
+void
+Simulation::setMaxSteps(int steps)
+{
+	if (steps < 1) { return; }
+	maxSteps = steps;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//time one GridSearch configuration over the pairs (start, end, start, end...)
+//and compare its costs with the shortest ones
+template <class Search>
+static void
+benchmarkSearch(const char* name, Grid* grid, const std::vector<GridNode*>& pairs, long long shortest)
+{
+	typedef std::chrono::steady_clock Clock;
+	Search search;
+	long long micro = 0;
+	long long expansions = 0;
+	long long cost = 0;
+	int searches = pairs.size() / 2;
+	for (int i = 0; i < searches; i++)
+	{
+		Clock::time_point began = Clock::now();
+		std::deque<GridNode*> path = search.findPath(grid, pairs[2 * i], pairs[2 * i + 1]);
+		micro += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - began).count();
+		expansions += search.getExpansions();
+		cost += grid->getPathCost(pairs[2 * i], path);
+	}
+	std::cout << "  " << name << ": " << micro / searches << " us, " << expansions / searches
+		<< " expansions per search, paths " << (shortest > 0 ? 100.0 * (cost - shortest) / shortest : 0.0) << "% longer" << std::endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//run A*, JPS, JPS+ and HPA* between the same random pairs of open nodes on
+//the current grid and print the average time per search for each. Blocked
+//picks are skipped, not counted. The debug grid is switched off while timing.
+//JPS and JPS+ should always agree on the cost, which is the shortest there
+//is; A* with its Manhattan estimate can come back longer, and HPA* trades
+//a little length for speed, how much is printed too.
+//Then the same for a few GridSearch configurations, on the pairs that had
+//a path: the first is the one aStar runs.
+void
+Simulation::benchmarkPaths(int queries)
+{
+	if (grid == NULL) { return; }
+
+	typedef std::chrono::steady_clock Clock;
+	static const char* modeNames[4] = { "A*", "JPS", "JPS+", "HPA*" };
+	long long total[4] = { 0, 0, 0, 0 };	//microseconds spent searching, per mode
+	int searches = 0;			//number of pairs timed
+	int found = 0;				//number of pairs with a path
+	int longer = 0;				//A* paths longer than the JPS one
+	int mismatched = 0;			//JPS and JPS+ disagreeing on the cost (should stay 0)
+	long long shortest = 0;		//summed JPS costs
+	long long hierarchical = 0;	//summed HPA* costs on the same pairs
+	std::vector<GridNode*> foundPairs;	//start, end, start, end... of the pairs with a path
+	paths->wait();				//nothing else searching while the timings run
+	grid->setPrintSearches(false);
+	grid->buildJumpTable();		//not part of the JPS+ timing
+	grid->buildHierarchy();		//or the HPA* timing
+	for (int i = 0; i < queries; i++)
+	{
+		GridNode* start = grid->getNode(rand() % grid->getNumRows(), rand() % grid->getNumCols());
+		GridNode* end = grid->getNode(rand() % grid->getNumRows(), rand() % grid->getNumCols());
+		if (!start->isClear() || !end->isClear()) { continue; }
+
+		std::deque<GridNode*> paths[4];
+		for (int mode = 0; mode < 4; mode++)
+		{
+			Clock::time_point began = Clock::now();
+			if (mode == SEARCH_ASTAR)
+				paths[mode] = grid->aStar(start, end);
+			else if (mode == SEARCH_HPA)
+				paths[mode] = grid->hierarchicalSearch(start, end);
+			else
+				paths[mode] = grid->jumpPointSearch(start, end, mode == SEARCH_JPS_PLUS);
+			total[mode] += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - began).count();
+		}
+		searches++;
+		if (paths[SEARCH_JPS].empty()) { continue; }
+		found++;
+		foundPairs.push_back(start);
+		foundPairs.push_back(end);
+		int cost = grid->getPathCost(start, paths[SEARCH_JPS]);
+		if (grid->getPathCost(start, paths[SEARCH_JPS_PLUS]) != cost) { mismatched++; }
+		if (grid->getPathCost(start, paths[SEARCH_ASTAR]) > cost) { longer++; }
+		shortest += cost;
+		hierarchical += grid->getPathCost(start, paths[SEARCH_HPA]);
+	}
+	grid->setPrintSearches(true);
+
+	std::cout << "Path benchmark: " << grid->getNumRows() << "x" << grid->getNumCols()
+		<< ", " << searches << " searches (" << found << " found)";
+	if (searches == 0)
+	{
+		std::cout << ", no open node pairs picked" << std::endl;
+		return;
+	}
+	for (int mode = 0; mode < 4; mode++)
+		std::cout << ", " << modeNames[mode] << " " << (total[mode] / searches) << " us";
+	std::cout << " per search" << std::endl;
+	std::cout << "  A* longer than JPS on " << longer << ", JPS/JPS+ cost mismatches: " << mismatched
+		<< ", HPA* paths " << (shortest > 0 ? 100.0 * (hierarchical - shortest) / shortest : 0.0) << "% longer" << std::endl;
+	if (found == 0) { return; }
+
+	std::cout << "Search configurations (" << found << " paths):" << std::endl;
+	benchmarkSearch<GridSearch<ManhattanHeuristic, EightConnected, IntCost> >("Manhattan, 8 way, int (aStar)", grid, foundPairs, shortest);
+	benchmarkSearch<GridSearch<OctileHeuristic, EightConnected, IntCost> >("octile, 8 way, int", grid, foundPairs, shortest);
+	benchmarkSearch<GridSearch<ChebyshevHeuristic, EightConnected, IntCost> >("Chebyshev, 8 way, int", grid, foundPairs, shortest);
+	benchmarkSearch<GridSearch<ZeroHeuristic, EightConnected, IntCost> >("none (Dijkstra), 8 way, int", grid, foundPairs, shortest);
+	benchmarkSearch<GridSearch<OctileHeuristic, EightConnected, FloatCost> >("octile, 8 way, float", grid, foundPairs, shortest);
+	benchmarkSearch<GridSearch<ManhattanHeuristic, FourConnected, IntCost> >("Manhattan, 4 way, int", grid, foundPairs, shortest);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//the same random queries between open nodes, searched one after another on
+//one context and then as a batch over the job system, with the grid's mode.
+//The batch has to come back with the same paths
+void
+Simulation::benchmarkBatch(int queries)
+{
+	if (grid == NULL || queries <= 0) { return; }
+
+	typedef std::chrono::steady_clock Clock;
+	std::vector<PathQuery> pairs;
+	for (int i = 0; i < queries; i++)
+	{
+		GridNode* start = grid->getNode(rand() % grid->getNumRows(), rand() % grid->getNumCols());
+		GridNode* end = grid->getNode(rand() % grid->getNumRows(), rand() % grid->getNumCols());
+		if (start->isClear() && end->isClear())
+			pairs.push_back(PathQuery(start, end));
+	}
+	if (pairs.empty())
+	{
+		std::cout << "Batch benchmark: no open node pairs picked" << std::endl;
+		return;
+	}
+
+	paths->pause();				//nothing else searching while the timings run
+	if (grid->needsPreparing()) { grid->prepareSearches(); }
+	SearchContext context;
+	std::vector<std::deque<GridNode*> > serial(pairs.size());
+	Clock::time_point began = Clock::now();
+	for (unsigned int i = 0; i < pairs.size(); i++)
+		serial[i] = grid->search(pairs[i].first, pairs[i].second, grid->getSearchMode(), context);
+	double serialMs = std::chrono::duration<double>(Clock::now() - began).count() * 1000.0;
+
+	began = Clock::now();
+	grid->findPaths(pairs, *batch, jobs);
+	double batchMs = std::chrono::duration<double>(Clock::now() - began).count() * 1000.0;
+	paths->resume();
+
+	int mismatched = 0;			//batch paths that differ from the serial ones (should stay 0)
+	int found = 0;
+	for (unsigned int i = 0; i < pairs.size(); i++)
+	{
+		const int* path = batch->getPath(i);
+		bool same = batch->getLength(i) == (int)serial[i].size();
+		for (int n = 0; same && n < batch->getLength(i); n++)
+			same = path[n] == serial[i][n]->getID();
+		if (!same) { mismatched++; }
+		if (!serial[i].empty()) { found++; }
+	}
+	std::cout << "Batch benchmark: " << grid->getNumRows() << "x" << grid->getNumCols() << ", "
+		<< pairs.size() << " queries (" << batch->getNumSearches() << " distinct, " << found << " found), "
+		<< serialMs << " ms one by one, " << batchMs << " ms as a batch on " << jobs->getNumThreads()
+		<< " thread(s), " << mismatched << " paths differ" << std::endl;
+}
@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////
+// The agent simulation, without any rendering
+// Owns the grid, the agents and the shared boid state, and steps them.
+// GameApplication is a Simulation with Ogre on top; the headless
+// build (HeadlessMain.cpp) drives one on its own.
+// The simulation always moves in steps of the same length (1 / step
+// rate), however long frames take; advance() banks frame time and runs
+// the steps that are due, and the scene is drawn between the last two.
+
+#pragma once
+#include <vector>
+#include "SimMath.h"
+#include "FlockState.h"
+#include "PathService.h"
+
+#define AGENT_BATCH 64	// agents per job in the parallel part of the update
+#define STEP_RATE 60.0	// default simulation steps per second
+#define MAX_STEPS 5		// most steps advance() runs in one frame, time beyond that is dropped
+
+// forward declarations ----------------
+class Agent;
+class Grid;
+class GridNode;
+class SpatialHash;
+class JobSystem;
+class PathBatch;
+struct FlockNeighbors;
+//--------------------------------------
+
+class Simulation
+{
+protected:
+	std::vector<Agent*> agentList; // Lecture 5: now a list of agents (kept contiguous, handed out by reference)
+	Grid* grid;				// store a pointer to the grid
+	bool demoMode;			//game is running demo mode
+	FlockState flock;		//boid positions, directions, speeds and flocking flags, one slot per agent
+	SpatialHash* agentHash;	//agents bucketed by position, rebuilt every frame
+	JobSystem* jobs;		//worker threads for the agent update
+	PathService* paths;		//worker threads for moveTo's searches
+	PathBatch* batch;		//paths for moveAgents, kept for the next batch
+	float neighborRadius;	//how far an agent looks for flockmates
+	Real stepRate;			//simulation steps per second
+	int maxSteps;			//most steps one advance() may run
+	Real accumulator;		//frame time banked but not yet stepped
+	Real interpolation;		//how far between the last two steps the scene is drawn (0 to 1)
+
+public:
+	Simulation(int numThreads = 0);	// 0: one thread per core
+	virtual ~Simulation();			// deletes the agents and the grid
+
+	void addAgent(Agent* a);		// the simulation owns it from now on
+	void setGrid(Grid* g);			// the simulation owns it from now on
+	void step(Real deltaTime);		// one step: think (serial), move (on the job system) and apply (serial) every agent
+	int advance(Real frameTime);	// run the fixed steps frameTime makes due, returns how many ran
+	void syncNodes();				// main thread: move the scene nodes to the interpolated positions
+	void followFlow(GridNode* goal);	// send every agent to goal along one shared flow field
+	int requestPath(Agent* a, GridNode* start, GridNode* goal, int priority = PATH_PRIORITY);	// search in the background, the path goes to a->receivePath() in a later step
+	void cancelPath(int ticket);		// a no longer wants that path
+	void setWalkable(GridNode* n, bool walkable);	// clear or block n, with the path workers paused
+	void moveAgents(const std::vector<GridNode*>& goals, bool snap = false);	// moveTo for every agent (agent i to goals[i]), the searches on the path service
+
+	Grid* getGrid() { return grid; }			//return the current level grid
+	const std::vector<Agent*>& getAgentList();	//return the current agent list, no copy
+	bool inDemoMode() { return demoMode; }	//check if in demo mode
+	void getNeighbors(const Vector3& pos, std::vector<int>& result);	//flock slots within the neighborhood radius of pos
+	void getFlockmates(int slot, const Vector3& pos, FlockNeighbors& result);	//packed state of the flocking agents near pos, except slot
+	FlockState& getFlockState() { return flock; }	//return the boid state shared by all agents
+	float getNeighborRadius() { return neighborRadius; }	//return the neighborhood radius
+	void setNeighborRadius(float radius);	//change the neighborhood radius
+	int getNumThreads();					//threads the agent update runs on
+	PathService* getPathService() { return paths; }	//return the background path searches
+	void setPathThreads(int numThreads);	//search on this many worker threads, 0: time sliced on the main thread
+	Real getStepRate() { return stepRate; }	//return the simulation steps per second
+	void setStepRate(Real hz);				//change the simulation steps per second
+	void setMaxSteps(int steps);			//change the most steps one frame may run
+	Real getInterpolation() { return interpolation; }	//return how far between the last two steps we are
+
+	void benchmarkPaths(int queries);	//time A*, JPS, JPS+, HPA* and the GridSearch configurations between random open nodes and print the results
+	void benchmarkBatch(int queries);	//time random queries one by one and as one batch, and print the results
+};
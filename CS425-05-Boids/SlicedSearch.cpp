@@ -0,0 +1,179 @@
+#include "SlicedSearch.h"
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+
+#define SLICE_CLOCK_CHECK 64	// expansions between looks at the clock, reading it costs more than an expansion
+
+SlicedSearch::SlicedSearch()
+{
+	grid = NULL;
+	start = -1;
+	goal = -1;
+	status = SLICE_FAILED;
+	expansions = 0;
+	revision = 0;
+	best = -1;
+	bestH = 0;
+	listMarker = 0;
+}
+
+SlicedSearch::~SlicedSearch()
+{}
+
+int
+SlicedSearch::estimate(int node)
+{
+	static const int diagonal_cost = sqrt(NODESIZE * NODESIZE + NODESIZE * NODESIZE);
+	int dR = std::abs(node / grid->getNumCols() - goal / grid->getNumCols());
+	int dC = std::abs(node % grid->getNumCols() - goal % grid->getNumCols());
+	return (int)NODESIZE * std::max(dR, dC) + (diagonal_cost - (int)NODESIZE) * std::min(dR, dC);
+}
+
+////////////////////////////////////////////////////////////////
+// start over from startNode. The scratch space is kept between searches
+// on the same grid, old list values just become obsolete
+void
+SlicedSearch::begin(Grid* g, GridNode* startNode, GridNode* goalNode)
+{
+	int numNodes = g->getNumRows() * g->getNumCols();
+	if (grid != g || (int)searchData.size() != numNodes)
+	{
+		searchData.assign(numNodes, SearchNode());
+		openList.resize(numNodes);
+		listMarker = 0;
+	}
+	grid = g;
+	revision = g->getRevision();
+	listMarker += 2;
+	openList.clear();
+	expansions = 0;
+	best = -1;
+	bestH = 0;
+	start = -1;
+	goal = -1;
+	status = SLICE_FAILED;
+	if (startNode == NULL || goalNode == NULL || !goalNode->isClear()) { return; }
+
+	start = startNode->getID();
+	goal = goalNode->getID();
+	status = SLICE_RUNNING;
+	SearchNode& first = searchData[start];
+	first.whichList = listMarker - 1;
+	first.gCost = 0;
+	first.parent = -1;
+	first.fCost = estimate(start);
+	openList.push(start, first.fCost);
+}
+
+////////////////////////////////////////////////////////////////
+// same moves and costs as Grid::aStar, but with the octile distance as
+// the estimate, so the path is a shortest one
+void
+SlicedSearch::expand(int node)
+{
+	static const int diagonal_cost = sqrt(NODESIZE * NODESIZE + NODESIZE * NODESIZE);
+	GridNode* current_node = grid->getNodeByID(node);
+	GridNode* neighbors[8];	// {North,South,East,West,NE,NW,SE,SW}, same order as getAllNeighbors
+	grid->getNeighbors(current_node, neighbors);
+	for (int i = 0; i < 8; i++)
+	{
+		if (neighbors[i] == NULL) { continue; }
+		int id = neighbors[i]->getID();
+		SearchNode& neighbor = searchData[id];
+		if (neighbor.whichList == listMarker) { continue; }	// closed
+
+		int new_gCost = searchData[node].gCost + (i < 4 ? (int)NODESIZE : diagonal_cost);
+		if (neighbor.whichList != listMarker - 1)
+		{
+			neighbor.whichList = listMarker - 1;
+			neighbor.gCost = new_gCost;
+			neighbor.parent = node;
+			neighbor.fCost = new_gCost + estimate(id);
+			openList.push(id, neighbor.fCost);
+		}
+		else if (new_gCost < neighbor.gCost)
+		{
+			neighbor.fCost += new_gCost - neighbor.gCost;
+			neighbor.gCost = new_gCost;
+			neighbor.parent = node;
+			openList.decreaseKey(id, neighbor.fCost);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////
+// expand nodes until the goal comes off the open list, the open list runs
+// dry or the budget is spent. Either limit can be 0 for none, not both
+SliceStatus
+SlicedSearch::resume(int maxExpansions, int maxMicroseconds)
+{
+	if (status != SLICE_RUNNING) { return status; }
+	if (grid->getRevision() != revision)	// the open and closed lists are of the old grid
+	{
+		int done = expansions;
+		begin(grid, grid->getNodeByID(start), grid->getNodeByID(goal));
+		expansions = done;
+		if (status != SLICE_RUNNING) { return status; }
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point deadline = Clock::now() + std::chrono::microseconds(maxMicroseconds);
+	for (int done = 0; maxExpansions <= 0 || done < maxExpansions; done++)
+	{
+		if (maxMicroseconds > 0 && done % SLICE_CLOCK_CHECK == SLICE_CLOCK_CHECK - 1 && Clock::now() >= deadline) { break; }
+		if (openList.empty())
+		{
+			status = SLICE_FAILED;
+			break;
+		}
+
+		int current = openList.pop();
+		searchData[current].whichList = listMarker;
+		expansions++;
+		int h = searchData[current].fCost - searchData[current].gCost;
+		if (best == -1 || h < bestH || (h == bestH && searchData[current].gCost < searchData[best].gCost))
+		{
+			best = current;
+			bestH = h;
+		}
+		if (current == goal)
+		{
+			status = SLICE_FOUND;
+			break;
+		}
+		expand(current);
+	}
+	return status;
+}
+
+GridNode*
+SlicedSearch::getGoal()
+{
+	if (grid == NULL || goal == -1) { return NULL; }
+	return grid->getNodeByID(goal);
+}
+
+std::deque<GridNode*>
+SlicedSearch::pathTo(int node)
+{
+	std::deque<GridNode*> path;
+	for (int current = node; current != start && current != -1; current = searchData[current].parent)
+		path.push_front(grid->getNodeByID(current));
+	return path;
+}
+
+std::deque<GridNode*>
+SlicedSearch::getPath()
+{
+	if (status != SLICE_FOUND) { return std::deque<GridNode*>(); }
+	return pathTo(goal);
+}
+
+std::deque<GridNode*>
+SlicedSearch::getPartialPath()
+{
+	if (best == -1) { return std::deque<GridNode*>(); }
+	return pathTo(best);
+}
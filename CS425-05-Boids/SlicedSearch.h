@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////
+// A* that can stop part way and carry on later
+// resume() expands nodes until the search is done or its budget (a number
+// of expansions and/or microseconds) runs out, so one hard search (an
+// unreachable goal on a big level sweeps everything it can reach before
+// giving up) can be spread over several frames instead of stalling one.
+// All its bookkeeping is its own, so the grid's other searches can run
+// in between. A search that has to be cut short still has an answer:
+// getPartialPath() leads to the node closest to the goal reached so far.
+// If the grid changes between slices what has been searched is out of
+// date, so resume() starts over (the expansions keep counting).
+
+#pragma once
+#include <vector>
+#include <deque>
+#include "Grid.h"
+
+enum SliceStatus {
+	SLICE_RUNNING,		// budget ran out, resume() again to carry on
+	SLICE_FOUND,		// getPath() is the path
+	SLICE_FAILED		// goal can't be reached, getPartialPath() gets as close as it can
+};
+
+class SlicedSearch
+{
+private:
+	Grid* grid;
+	int start;					// node IDs
+	int goal;
+	SliceStatus status;
+	int expansions;				// nodes taken off the open list so far
+	int revision;				// grid revision the search is on
+	int best;					// closed node with the lowest estimate to the goal (ties: the cheaper one)
+	int bestH;
+
+	std::vector<SearchNode> searchData;	// costs, lists and parents, by node ID
+	OpenList openList;
+	int listMarker;				// closed list value of this search, open is one less
+
+	int estimate(int node);		// octile distance to the goal
+	void expand(int node);		// open the neighbors of node
+	std::deque<GridNode*> pathTo(int node);	// walk back from node, start left off
+
+public:
+	SlicedSearch();
+	~SlicedSearch();
+
+	void begin(Grid* g, GridNode* startNode, GridNode* goalNode);	// set up a new search, nothing is expanded yet
+	SliceStatus resume(int maxExpansions, int maxMicroseconds = 0);	// carry on for at most that many expansions and/or microseconds (0 = no limit), starting over if the grid changed
+	SliceStatus getStatus() { return status; }
+	int getExpansions() { return expansions; }
+	GridNode* getGoal();
+	std::deque<GridNode*> getPath();		// start left off, end included, empty until found
+	std::deque<GridNode*> getPartialPath();	// path to the closest node to the goal so far (the whole path once found)
+};
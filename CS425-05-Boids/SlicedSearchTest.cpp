@@ -0,0 +1,44 @@
+////////////////////////////////////////////////////////
+// A time sliced search has to notice the grid changing between slices:
+// a node it has already put on the open list is blocked, and the path it
+// delivers must go around it. ctest runs this (CMakeLists.txt).
+
+#include "SlicedSearch.h"
+#include <iostream>
+
+int main()
+{
+	Grid grid(5, 12);
+	GridNode* start = grid.getNode(2, 0);
+	GridNode* goal = grid.getNode(2, 11);
+	GridNode* blocked = grid.getNode(2, 6);
+
+	SlicedSearch search;
+	search.begin(&grid, start, goal);
+	if (search.resume(6) != SLICE_RUNNING)	// straight along row 2, (2,6) is open by now
+	{
+		std::cout << "FAIL: search finished in the first slice" << std::endl;
+		return 1;
+	}
+	blocked->setOccupied();
+
+	if (search.resume(0) != SLICE_FOUND)
+	{
+		std::cout << "FAIL: no path after the change" << std::endl;
+		return 1;
+	}
+	std::deque<GridNode*> path = search.getPath();
+	if (path.empty() || path.back() != goal)
+	{
+		std::cout << "FAIL: path doesn't end at the goal" << std::endl;
+		return 1;
+	}
+	for (unsigned int i = 0; i < path.size(); i++)
+		if (path[i] == blocked || !path[i]->isClear())
+		{
+			std::cout << "FAIL: path goes through a blocked node" << std::endl;
+			return 1;
+		}
+	std::cout << "ok: " << path.size() << " nodes, around the blocked one" << std::endl;
+	return 0;
+}
@@ -0,0 +1,144 @@
+#include "SpatialHash.h"
+#include "FlockState.h"
+#include "FlockKernel.h"
+#include <cmath>
+#include <assert.h>
+
+////////////////////////////////////////////////////////////////
+// create an empty hash
+SpatialHash::SpatialHash(float cellSize)
+{
+	this->cellSize = cellSize;
+	this->tableMask = 0;
+}
+
+////////////////////////////////////////////////////////////////
+// destroy the hash, it does not own the flock
+SpatialHash::~SpatialHash()
+{}
+
+void
+SpatialHash::setCellSize(float size)
+{
+	assert(size > 0);
+	this->cellSize = size;
+}
+
+int
+SpatialHash::cellOf(float coord)
+{
+	return (int)std::floor(coord / cellSize);
+}
+
+int
+SpatialHash::bucketOf(int cx, int cz)
+{
+	unsigned int h = ((unsigned int)cx * 73856093u) ^ ((unsigned int)cz * 19349663u);
+	return h & tableMask;
+}
+
+////////////////////////////////////////////////////////////////
+// rehash every boid at its current position.
+// counting sort into flat arrays, so once the vectors have grown to
+// fit the flock a rebuild does not allocate.
+void
+SpatialHash::build(const FlockState& flock)
+{
+	int count = flock.posX.size();
+
+	int numBuckets = 1;		// keep about two buckets per boid
+	while (numBuckets < 2 * count)
+		numBuckets *= 2;
+	tableMask = numBuckets - 1;
+
+	bucketStart.assign(numBuckets + 1, 0);
+	entries.resize(count);
+	posX.resize(count); posY.resize(count); posZ.resize(count);
+	dirX.resize(count); dirY.resize(count); dirZ.resize(count);
+	flocking.resize(count);
+
+	// count the boids in each bucket
+	for (int i = 0; i < count; i++)
+		bucketStart[bucketOf(cellOf(flock.posX[i]), cellOf(flock.posZ[i])) + 1]++;
+	// turn counts into starting offsets
+	for (int b = 0; b < numBuckets; b++)
+		bucketStart[b + 1] += bucketStart[b];
+
+	// drop each boid into its bucket, using bucketStart[b] as the fill cursor
+	for (int i = 0; i < count; i++)
+	{
+		Entry e;
+		e.slot = i;
+		e.cx = cellOf(flock.posX[i]);
+		e.cz = cellOf(flock.posZ[i]);
+		int k = bucketStart[bucketOf(e.cx, e.cz)]++;
+		entries[k] = e;
+		posX[k] = flock.posX[i]; posY[k] = flock.posY[i]; posZ[k] = flock.posZ[i];
+		dirX[k] = flock.dirX[i]; dirY[k] = flock.dirY[i]; dirZ[k] = flock.dirZ[i];
+		flocking[k] = flock.flocking[i];
+	}
+	// the fill moved every start to the end of its bucket, shift them back
+	for (int b = numBuckets; b > 0; b--)
+		bucketStart[b] = bucketStart[b - 1];
+	bucketStart[0] = 0;
+}
+
+////////////////////////////////////////////////////////////////
+// collect the slots of the boids within radius of (x,y,z) into result.
+// result is cleared first but keeps its capacity, so callers can reuse it.
+void
+SpatialHash::query(float x, float y, float z, float radius, std::vector<int>& result)
+{
+	result.clear();
+	if (entries.empty()) { return; }
+
+	int minX = cellOf(x - radius), maxX = cellOf(x + radius);
+	int minZ = cellOf(z - radius), maxZ = cellOf(z + radius);
+	float radiusSq = radius * radius;
+
+	for (int cx = minX; cx <= maxX; cx++)
+	{
+		for (int cz = minZ; cz <= maxZ; cz++)
+		{
+			int b = bucketOf(cx, cz);
+			for (int i = bucketStart[b]; i < bucketStart[b + 1]; i++)
+			{
+				if (entries[i].cx != cx || entries[i].cz != cz) { continue; }	// another cell hashed to this bucket
+				float dx = posX[i] - x, dy = posY[i] - y, dz = posZ[i] - z;
+				if (dx * dx + dy * dy + dz * dz < radiusSq)
+					result.push_back(entries[i].slot);
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////
+// copy the position and direction of every flocking boid within radius
+// of (x,y,z), other than self, into result's packed arrays for the flocking kernel.
+// result keeps its capacity between calls.
+void
+SpatialHash::gatherFlockmates(int self, float x, float y, float z, float radius, FlockNeighbors& result)
+{
+	result.clear();
+	if (entries.empty()) { return; }
+
+	int minX = cellOf(x - radius), maxX = cellOf(x + radius);
+	int minZ = cellOf(z - radius), maxZ = cellOf(z + radius);
+	float radiusSq = radius * radius;
+
+	for (int cx = minX; cx <= maxX; cx++)
+	{
+		for (int cz = minZ; cz <= maxZ; cz++)
+		{
+			int b = bucketOf(cx, cz);
+			for (int i = bucketStart[b]; i < bucketStart[b + 1]; i++)
+			{
+				if (entries[i].cx != cx || entries[i].cz != cz) { continue; }	// another cell hashed to this bucket
+				if (entries[i].slot == self || !flocking[i]) { continue; }
+				float dx = posX[i] - x, dy = posY[i] - y, dz = posZ[i] - z;
+				if (dx * dx + dy * dy + dz * dz < radiusSq)
+					result.add(posX[i], posY[i], posZ[i], dirX[i], dirY[i], dirZ[i]);
+			}
+		}
+	}
+}
@@ -0,0 +1,47 @@
+////////////////////////////////////////////////////////
+// Uniform spatial hash over boid positions
+// Rebuilt once per tick so flocking only looks at nearby agents
+// instead of the whole agent list. The build also takes a packed,
+// cell-sorted copy of the flock state, so neighbor reads during the
+// tick are contiguous and see the flock as it was when the tick started.
+
+#pragma once
+#include <vector>
+
+//forward declarations -----
+class FlockState;
+struct FlockNeighbors;
+//--------------------------
+
+class SpatialHash
+{
+private:
+	struct Entry {
+		int slot;			// flock slot of the boid in this cell
+		int cx;				// cell coordinates the boid was hashed from,
+		int cz;				// so collisions between cells can be filtered out
+	};
+
+	float cellSize;					// width of a cell, same as the neighborhood radius
+	int tableMask;					// number of buckets - 1 (number of buckets is a power of 2)
+	std::vector<int> bucketStart;	// first entry of each bucket, bucketStart[b+1] is one past its last
+	std::vector<Entry> entries;		// boids sorted by bucket
+
+	// flock state copied in entry order when the hash is built
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> dirX, dirY, dirZ;
+	std::vector<char> flocking;
+
+	int cellOf(float coord);		// cell coordinate along one axis
+	int bucketOf(int cx, int cz);	// bucket a cell hashes to
+public:
+	SpatialHash(float cellSize);
+	~SpatialHash();
+
+	void setCellSize(float size);	// change the cell size, takes effect at the next build
+	float getCellSize() { return cellSize; }
+
+	void build(const FlockState& flock);	// rehash every boid at its current position
+	void query(float x, float y, float z, float radius, std::vector<int>& result);	// slots of the boids within radius of (x,y,z)
+	void gatherFlockmates(int self, float x, float y, float z, float radius, FlockNeighbors& result);	// packed state of the flocking boids within radius, except self
+};
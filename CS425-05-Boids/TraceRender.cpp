@@ -0,0 +1,161 @@
+////////////////////////////////////////////////////////
+// Offline renderer for the search traces (SearchTrace.h)
+// Reads a <level>Trace.bin and writes one ASCII grid per search, the same
+// grids Grid::printToFile used to write after every aStar:
+//   . open ground   B blocked   ~ closed   - still open
+//   S start   0-9 the path, counting from the start   E goal
+//   X start of a search that found no path
+// Files are named <level>NGrid.txt, N going 1 to 9 and round again, so
+// like before only the last nine searches are left.
+//
+//   trace_render levelBoids.txtTrace.bin [output directory]
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include "SearchTrace.h"
+
+struct TraceGrid {		// the walls, as of the last TRACE_GRID record
+	int rows;
+	int cols;
+	std::string name;
+	std::vector<char> cells;	// '.' or 'B', row major
+};
+
+static bool
+readGrid(const std::vector<int>& record, TraceGrid& grid)
+{
+	if (record.size() < 8) { return false; }
+	grid.rows = record[2];
+	grid.cols = record[3];
+	int rowWords = record[5];
+	int nameLength = record[6];
+	if (grid.rows <= 0 || grid.cols <= 0 || rowWords != (grid.cols + 63) / 64 || nameLength < 0
+		|| 8 + (size_t)grid.rows * rowWords * 2 + (nameLength + sizeof(int) - 1) / sizeof(int) > record.size()) { return false; }
+	grid.cells.assign(grid.rows * grid.cols, 'B');
+	for (int r = 0; r < grid.rows; r++)		// a bit per walkable node, rows of 64 bit words
+		for (int c = 0; c < grid.cols; c++)
+		{
+			unsigned long long word;
+			memcpy(&word, &record[8 + 2 * ((size_t)r * rowWords + c / 64)], sizeof(word));
+			if ((word >> (c % 64)) & 1)
+				grid.cells[r * grid.cols + c] = '.';
+		}
+	grid.name.assign((const char*)&record[8 + (size_t)grid.rows * rowWords * 2], nameLength);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////
+// marked in the order aStar used to mark the nodes, so later marks win
+static bool
+writeSearch(const std::vector<int>& record, const TraceGrid& grid, const std::string& fileName)
+{
+	if (record.size() < 9 || grid.cells.empty()) { return false; }
+	int start = record[3];
+	int goal = record[4];
+	bool found = record[5] != 0;
+	int numClosed = record[6];
+	int numOpen = record[7];
+	int numPath = record[8];
+	int numNodes = grid.rows * grid.cols;
+	if (numClosed < 0 || numOpen < 0 || numPath < 0
+		|| 9 + (size_t)numClosed + numOpen + numPath > record.size()) { return false; }
+	for (size_t i = 9; i < 9 + (size_t)numClosed + numOpen + numPath; i++)
+		if (record[i] < 0 || record[i] >= numNodes) { return false; }
+	if (start < 0 || start >= numNodes || goal < 0 || goal >= numNodes) { return false; }
+
+	std::vector<char> cells = grid.cells;
+	const int* ids = &record[9];
+	for (int i = 0; i < numClosed; i++)
+		cells[*ids++] = '~';
+	for (int i = 0; i < numOpen; i++)
+		cells[*ids++] = '-';
+	if (!found)
+		cells[start] = 'X';	//X for no path found
+	else
+	{
+		cells[start] = 'S';
+		char count = '0';
+		for (int i = 0; i < numPath; i++)
+		{
+			cells[*ids++] = count;
+			if (count == '9') { count = '0'; }
+			else count++;
+		}
+	}
+	cells[goal] = 'E';
+
+	std::ofstream outFile(fileName.c_str());
+	if (!outFile.is_open())
+	{
+		std::cout << "ERROR, FILE COULD NOT BE OPENED: " << fileName << std::endl;
+		return false;
+	}
+	for (int r = 0; r < grid.rows; r++)
+	{
+		for (int c = 0; c < grid.cols; c++)
+			outFile << cells[r * grid.cols + c] << " ";
+		outFile << std::endl;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2 || argc > 3)
+	{
+		std::cout << "usage: " << argv[0] << " <trace file> [output directory]" << std::endl;
+		return 1;
+	}
+	std::ifstream in(argv[1], std::ios::in | std::ios::binary);
+	if (!in.is_open())
+	{
+		std::cout << "ERROR, FILE COULD NOT BE OPENED: " << argv[1] << std::endl;
+		return 1;
+	}
+	std::string directory = argc == 3 ? std::string(argv[2]) + "/" : "";
+
+	TraceGrid grid;
+	std::vector<int> record;
+	int searches = 0;
+	int count = 0;		//same numbering printToFile had
+	TraceHeader header;
+	while (in.read((char*)&header, sizeof(header)))
+	{
+		if (header.size < (int)sizeof(header) || header.size % sizeof(int) != 0)
+		{
+			std::cout << "ERROR, BAD RECORD AFTER " << searches << " SEARCHES" << std::endl;
+			return 1;
+		}
+		record.resize(header.size / sizeof(int));
+		memcpy(&record[0], &header, sizeof(header));
+		if (header.size > (int)sizeof(header) && !in.read((char*)&record[2], header.size - sizeof(header)))
+		{
+			std::cout << "ERROR, TRACE ENDS PART WAY THROUGH A RECORD" << std::endl;
+			return 1;
+		}
+
+		bool good = true;
+		if (header.type == TRACE_GRID)
+			good = readGrid(record, grid);
+		else if (header.type == TRACE_SEARCH)
+		{
+			if (count == 9) { count = 0; }
+			count++;
+			std::ostringstream fileName;
+			fileName << directory << grid.name << count << "Grid.txt";
+			good = writeSearch(record, grid, fileName.str());
+			searches++;
+		}
+		if (!good)
+		{
+			std::cout << "ERROR, BAD RECORD AFTER " << searches << " SEARCHES" << std::endl;
+			return 1;
+		}
+	}
+	std::cout << searches << " searches rendered" << std::endl;
+	return 0;
+}